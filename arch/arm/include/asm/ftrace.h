@@ -28,6 +28,15 @@ extern void ftrace_call_old(void);
 
 #endif
 
+/*
+ * ARM mode call sites using __gnu_mcount_nc can be redirected from
+ * ftrace_caller to a per-ops trampoline allocated in module space.
+ */
+#if defined(CONFIG_DYNAMIC_FTRACE) && defined(CONFIG_MODULES) && \
+	!defined(CONFIG_THUMB2_KERNEL) && !defined(CONFIG_OLD_MCOUNT)
+#define ARCH_HAS_FTRACE_MODIFY_CALL
+#endif
+
 #endif
 
 #ifndef __ASSEMBLY__
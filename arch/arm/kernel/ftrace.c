@@ -15,12 +15,14 @@
 #include <linux/ftrace.h>
 #include <linux/uaccess.h>
 #include <linux/module.h>
+#include <linux/moduleloader.h>
 #include <linux/stop_machine.h>
 
 #include <asm/cacheflush.h>
 #include <asm/opcodes.h>
 #include <asm/ftrace.h>
 #include <asm/insn.h>
+#include <asm/sections.h>
 
 #ifdef CONFIG_THUMB2_KERNEL
 #define	NOP		0xf85deb04	/* pop.w {lr} */
@@ -188,6 +190,129 @@ int ftrace_make_nop(struct module *mod,
 	return ret;
 }
 
+#ifdef ARCH_HAS_FTRACE_MODIFY_CALL
+int ftrace_modify_call(struct dyn_ftrace *rec, unsigned long old_addr,
+		       unsigned long addr)
+{
+	unsigned long ip = rec->ip;
+	unsigned long old, new;
+
+	old = ftrace_call_replace(ip, old_addr);
+	new = ftrace_call_replace(ip, addr);
+	if (!old || !new)
+		return -EINVAL;
+
+	return ftrace_modify_code(ip, old, new, true);
+}
+
+extern char ftrace_tramp_template[];
+extern char ftrace_tramp_ops[];
+extern char ftrace_tramp_func[];
+extern char ftrace_tramp_end[];
+
+#define TRAMP_OFFSET(sym)	((sym) - ftrace_tramp_template)
+
+/*
+ * Both kernel and module call sites are patched with a plain bl, so a
+ * trampoline is only usable if it ended up in the module area and within
+ * branch range of all of the kernel text.  module_alloc() may fall back to
+ * the vmalloc area with ARM_MODULE_PLTS, which is too far away.
+ */
+static bool tramp_in_range(unsigned long tramp)
+{
+	if (tramp < MODULES_VADDR || tramp >= MODULES_END)
+		return false;
+
+	return arm_gen_branch_link((unsigned long)_stext, tramp) &&
+	       arm_gen_branch_link((unsigned long)_etext, tramp);
+}
+
+static unsigned long create_trampoline(struct ftrace_ops *ops)
+{
+	unsigned long size = TRAMP_OFFSET(ftrace_tramp_end);
+	unsigned long tramp;
+	void *p;
+
+	p = module_alloc(size);
+	if (!p)
+		return 0;
+
+	tramp = (unsigned long)p;
+	if (!tramp_in_range(tramp)) {
+		module_memfree(p);
+		return 0;
+	}
+
+	memcpy(p, ftrace_tramp_template, size);
+	*(unsigned long *)(p + TRAMP_OFFSET(ftrace_tramp_ops)) =
+		(unsigned long)ops;
+	flush_icache_range(tramp, tramp + size);
+
+	ops->trampoline_size = size;
+	/* ALLOC_TRAMP flags lets us know we created it */
+	ops->flags |= FTRACE_OPS_FL_ALLOC_TRAMP;
+
+	return tramp;
+}
+
+/*
+ * Give ops that get a trampoline its own copy of ftrace_tramp_template, so
+ * that call sites only traced by this ops call straight into its callback
+ * instead of walking the ftrace_ops list.
+ */
+void arch_ftrace_update_trampoline(struct ftrace_ops *ops)
+{
+	unsigned long *func;
+
+	if (ops->trampoline) {
+		/*
+		 * The ftrace_ops caller may set up its own trampoline.
+		 * In such a case, this code must not modify it.
+		 */
+		if (!(ops->flags & FTRACE_OPS_FL_ALLOC_TRAMP))
+			return;
+	} else {
+		/*
+		 * The template has neither a pt_regs frame nor the function
+		 * graph hook; ops needing those stay on ftrace_caller.  The
+		 * graph tracer's own ops is a STUB that hooks ftrace_caller.
+		 */
+		if (ops->flags & (FTRACE_OPS_FL_SAVE_REGS | FTRACE_OPS_FL_STUB))
+			return;
+
+		ops->trampoline = create_trampoline(ops);
+		if (!ops->trampoline)
+			return;
+	}
+
+	/*
+	 * The callback is loaded from a literal on every call, so a single
+	 * word store switches it even if the trampoline is running.
+	 */
+	func = (unsigned long *)(ops->trampoline +
+				 TRAMP_OFFSET(ftrace_tramp_func));
+	WRITE_ONCE(*func, (unsigned long)ftrace_ops_get_func(ops));
+}
+
+void *arch_ftrace_trampoline_func(struct ftrace_ops *ops, struct dyn_ftrace *rec)
+{
+	if (!ops || !(ops->flags & FTRACE_OPS_FL_ALLOC_TRAMP))
+		return NULL;
+
+	return (void *)*(unsigned long *)(ops->trampoline +
+					  TRAMP_OFFSET(ftrace_tramp_func));
+}
+
+void arch_ftrace_trampoline_free(struct ftrace_ops *ops)
+{
+	if (!ops || !(ops->flags & FTRACE_OPS_FL_ALLOC_TRAMP))
+		return;
+
+	module_memfree((void *)ops->trampoline);
+	ops->trampoline = 0;
+}
+#endif /* ARCH_HAS_FTRACE_MODIFY_CALL */
+
 int __init ftrace_dyn_arch_init(void)
 {
 	return 0;
@@ -1,5 +1,5 @@
 /*
- * Just-In-Time compiler for BPF filters on 32bit ARM
+ * Just-In-Time compiler for BPF filters and eBPF programs on 32bit ARM
  *
  * Copyright (c) 2011 Mircea Gherzan <mgherzan@gmail.com>
  *
@@ -16,6 +16,7 @@
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <linux/if_vlan.h>
+#include <linux/math64.h>
 
 #include <asm/cacheflush.h>
 #include <asm/hwcap.h>
@@ -65,6 +66,7 @@ struct jit_ctx {
 	u32 flags;
 	u32 *offsets;
 	u32 *target;
+	unsigned epilogue_offset;
 #if __LINUX_ARM_ARCH__ < 7
 	u16 epilogue_bytes;
 	u16 imm_count;
@@ -1067,6 +1069,1048 @@ out:
 	return;
 }
 
+#if defined(CONFIG_ARM_EBPF_JIT) && __LINUX_ARM_ARCH__ >= 7
+
+/*
+ * eBPF JIT
+ *
+ * eBPF registers are 64 bits wide and are mapped to {hi, lo} pairs of
+ * core registers. There are not enough of those for all of them, so
+ * only R0 (return value), R1 (first helper argument) and R6 (context)
+ * are kept in registers. The others live in a scratch area at the
+ * bottom of the stack frame and are loaded into the temporaries around
+ * each instruction. r10, ip and lr are free for use as scratch.
+ *
+ * Stack frame, from the stack pointer upwards:
+ *
+ *	[sp +   0]	R3, R4, R5 (also the stacked arguments of a helper)
+ *	[sp +  24]	R2, R7, R8, R9, FP
+ *	[sp +  64]	tail call count
+ *	[sp +  72]	program stack, MAX_BPF_STACK bytes
+ *	[sp + 584]	saved r4-r10, lr		<- BPF FP
+ */
+
+enum {
+	BPF_R3_LO, BPF_R3_HI,
+	BPF_R4_LO, BPF_R4_HI,
+	BPF_R5_LO, BPF_R5_HI,
+	BPF_R2_LO, BPF_R2_HI,
+	BPF_R7_LO, BPF_R7_HI,
+	BPF_R8_LO, BPF_R8_HI,
+	BPF_R9_LO, BPF_R9_HI,
+	BPF_FP_LO, BPF_FP_HI,
+	BPF_TC_LO, BPF_TC_HI,
+	BPF_JIT_SCRATCH_WORDS,
+};
+
+#define EBPF_SCRATCH_SIZE	(BPF_JIT_SCRATCH_WORDS * 4)
+#define EBPF_STACK_SIZE		(EBPF_SCRATCH_SIZE + MAX_BPF_STACK)
+
+#define EBPF_SAVED_REGS		((1 << ARM_R4) | (1 << ARM_R5) | \
+				 (1 << ARM_R6) | (1 << ARM_R7) | \
+				 (1 << ARM_R8) | (1 << ARM_R9) | \
+				 (1 << ARM_R10))
+
+#define STACKED			0x100
+#define STACK_SLOT(k)		(STACKED | (k) * 4)
+#define STACK_OFF(reg)		((reg) & 0xff)
+#define is_stacked(reg)		((reg) & STACKED)
+
+#define ARM_INST_U_BIT		(1 << 23)
+
+/* eBPF register -> {hi, lo} */
+static const s16 bpf2a32[MAX_BPF_REG][2] = {
+	[BPF_REG_0] = {ARM_R1, ARM_R0},
+	[BPF_REG_1] = {ARM_R3, ARM_R2},
+	[BPF_REG_2] = {STACK_SLOT(BPF_R2_HI), STACK_SLOT(BPF_R2_LO)},
+	[BPF_REG_3] = {STACK_SLOT(BPF_R3_HI), STACK_SLOT(BPF_R3_LO)},
+	[BPF_REG_4] = {STACK_SLOT(BPF_R4_HI), STACK_SLOT(BPF_R4_LO)},
+	[BPF_REG_5] = {STACK_SLOT(BPF_R5_HI), STACK_SLOT(BPF_R5_LO)},
+	[BPF_REG_6] = {ARM_R5, ARM_R4},
+	[BPF_REG_7] = {STACK_SLOT(BPF_R7_HI), STACK_SLOT(BPF_R7_LO)},
+	[BPF_REG_8] = {STACK_SLOT(BPF_R8_HI), STACK_SLOT(BPF_R8_LO)},
+	[BPF_REG_9] = {STACK_SLOT(BPF_R9_HI), STACK_SLOT(BPF_R9_LO)},
+	[BPF_REG_FP] = {STACK_SLOT(BPF_FP_HI), STACK_SLOT(BPF_FP_LO)},
+};
+
+/* temporaries for the destination and the source operand */
+static const u8 tmp1[2] = {ARM_R7, ARM_R6};
+static const u8 tmp2[2] = {ARM_R9, ARM_R8};
+
+static u64 jit_udiv64(u64 dividend, u64 divisor)
+{
+	return div64_u64(dividend, divisor);
+}
+
+static u64 jit_mod64(u64 dividend, u64 divisor)
+{
+	u64 rem;
+
+	div64_u64_rem(dividend, divisor, &rem);
+	return rem;
+}
+
+/* Branch offset from the current instruction to instruction @tgt. */
+static inline u32 ebpf_b_imm(unsigned tgt, struct jit_ctx *ctx)
+{
+	if (ctx->target == NULL)
+		return 0;
+
+	/* PC in ARM mode == address of the instruction + 8 */
+	return tgt - (ctx->idx + 2);
+}
+
+/* Return the core register holding the low word of @reg. */
+static u8 ebpf_get_lo(const s16 *reg, u8 tmp, struct jit_ctx *ctx)
+{
+	if (is_stacked(reg[1])) {
+		emit(ARM_LDR_I(tmp, ARM_SP, STACK_OFF(reg[1])), ctx);
+		return tmp;
+	}
+	return reg[1];
+}
+
+/* Fill @rd with the core registers holding both words of @reg. */
+static void ebpf_get_reg64(const s16 *reg, const u8 *tmp, u8 *rd,
+			   struct jit_ctx *ctx)
+{
+	if (is_stacked(reg[1])) {
+		emit(ARM_LDR_I(tmp[1], ARM_SP, STACK_OFF(reg[1])), ctx);
+		emit(ARM_LDR_I(tmp[0], ARM_SP, STACK_OFF(reg[0])), ctx);
+		rd[0] = tmp[0];
+		rd[1] = tmp[1];
+	} else {
+		rd[0] = reg[0];
+		rd[1] = reg[1];
+	}
+}
+
+static void ebpf_put_reg64(const s16 *reg, const u8 *rs, struct jit_ctx *ctx)
+{
+	if (is_stacked(reg[1])) {
+		emit(ARM_STR_I(rs[1], ARM_SP, STACK_OFF(reg[1])), ctx);
+		emit(ARM_STR_I(rs[0], ARM_SP, STACK_OFF(reg[0])), ctx);
+	} else {
+		if (reg[1] != rs[1])
+			emit(ARM_MOV_R(reg[1], rs[1]), ctx);
+		if (reg[0] != rs[0])
+			emit(ARM_MOV_R(reg[0], rs[0]), ctx);
+	}
+}
+
+/* Store a 32-bit result; the high word is zero extended. */
+static void ebpf_put_reg32(const s16 *reg, u8 rs, struct jit_ctx *ctx)
+{
+	if (is_stacked(reg[1])) {
+		emit(ARM_STR_I(rs, ARM_SP, STACK_OFF(reg[1])), ctx);
+		emit(ARM_MOV_I(ARM_IP, 0), ctx);
+		emit(ARM_STR_I(ARM_IP, ARM_SP, STACK_OFF(reg[0])), ctx);
+	} else {
+		if (reg[1] != rs)
+			emit(ARM_MOV_R(reg[1], rs), ctx);
+		emit(ARM_MOV_I(reg[0], 0), ctx);
+	}
+}
+
+/* Load the sign extended immediate @imm into @rd. */
+static void ebpf_mov_i64(const u8 *rd, s32 imm, struct jit_ctx *ctx)
+{
+	emit_mov_i(rd[1], imm, ctx);
+	emit_mov_i(rd[0], imm < 0 ? ~0U : 0, ctx);
+}
+
+/*
+ * Load or store @size bytes between @rt and [@rn + @off]. Offsets out
+ * of range for the immediate forms are materialised in ip.
+ */
+static void ebpf_ldst(bool load, u8 size, u8 rt, u8 rn, s32 off,
+		      struct jit_ctx *ctx)
+{
+	u32 aoff = off < 0 ? -off : off;
+	u32 inst;
+
+	if (aoff > (size == BPF_H ? 0xff : 0xfff)) {
+		emit_mov_i(ARM_IP, off, ctx);
+		switch (size) {
+		case BPF_B:
+			inst = load ? ARM_LDRB_R(rt, rn, ARM_IP) :
+				      ARM_STRB_R(rt, rn, ARM_IP);
+			break;
+		case BPF_H:
+			inst = load ? ARM_LDRH_R(rt, rn, ARM_IP) :
+				      ARM_STRH_R(rt, rn, ARM_IP);
+			break;
+		default:
+			inst = load ? ARM_LDR_R(rt, rn, ARM_IP) :
+				      ARM_STR_R(rt, rn, ARM_IP);
+			break;
+		}
+		emit(inst, ctx);
+		return;
+	}
+
+	switch (size) {
+	case BPF_B:
+		inst = load ? ARM_LDRB_I(rt, rn, aoff) : ARM_STRB_I(rt, rn, aoff);
+		break;
+	case BPF_H:
+		inst = load ? ARM_LDRH_I(rt, rn, aoff) : ARM_STRH_I(rt, rn, aoff);
+		break;
+	default:
+		inst = load ? ARM_LDR_I(rt, rn, aoff) : ARM_STR_I(rt, rn, aoff);
+		break;
+	}
+	if (off < 0)
+		inst &= ~ARM_INST_U_BIT;
+	emit(inst, ctx);
+}
+
+/* Leave the program with a return value of 0 if @cond holds. */
+static void ebpf_exit_if(u8 cond, struct jit_ctx *ctx)
+{
+	_emit(cond, ARM_MOV_I(ARM_R0, 0), ctx);
+	_emit(cond, ARM_MOV_I(ARM_R1, 0), ctx);
+	_emit(cond, ARM_B(ebpf_b_imm(ctx->epilogue_offset, ctx)), ctx);
+}
+
+/*
+ * Call the C function @func with the eBPF arguments R1-R5. R1 and R2 go
+ * in r0-r3 and R3-R5 already sit where AAPCS expects the stacked
+ * arguments. The 64-bit result lands in r0/r1, which is BPF R0.
+ */
+static void ebpf_call(u32 func, struct jit_ctx *ctx)
+{
+	const s16 *r2 = bpf2a32[BPF_REG_2];
+
+	emit(ARM_MOV_R(ARM_R0, ARM_R2), ctx);
+	emit(ARM_MOV_R(ARM_R1, ARM_R3), ctx);
+	emit(ARM_LDR_I(ARM_R2, ARM_SP, STACK_OFF(r2[1])), ctx);
+	emit(ARM_LDR_I(ARM_R3, ARM_SP, STACK_OFF(r2[0])), ctx);
+	emit_mov_i(ARM_IP, func, ctx);
+	emit_blx_r(ARM_IP, ctx);
+}
+
+/*
+ * rd = rd / rs or rd % rs on the low words. Without a hardware divider
+ * this calls out to C, preserving BPF R0 and R1 around the call.
+ */
+static void ebpf_udivmod32(u8 rd, u8 rs, u8 op, struct jit_ctx *ctx)
+{
+	u32 func = op == BPF_DIV ? (u32)jit_udiv : (u32)jit_mod;
+
+	if (elf_hwcap & HWCAP_IDIVA) {
+		if (op == BPF_DIV) {
+			emit(ARM_UDIV(rd, rd, rs), ctx);
+		} else {
+			emit(ARM_UDIV(ARM_IP, rd, rs), ctx);
+			emit(ARM_MLS(rd, ARM_IP, rs, rd), ctx);
+		}
+		return;
+	}
+
+	emit(ARM_PUSH((1 << ARM_R0) | (1 << ARM_R1) |
+		      (1 << ARM_R2) | (1 << ARM_R3)), ctx);
+	emit(ARM_MOV_R(ARM_IP, rs), ctx);
+	if (rd != ARM_R0)
+		emit(ARM_MOV_R(ARM_R0, rd), ctx);
+	emit(ARM_MOV_R(ARM_R1, ARM_IP), ctx);
+	emit_mov_i(ARM_IP, func, ctx);
+	emit_blx_r(ARM_IP, ctx);
+	emit(ARM_MOV_R(ARM_IP, ARM_R0), ctx);
+	emit(ARM_POP((1 << ARM_R0) | (1 << ARM_R1) |
+		     (1 << ARM_R2) | (1 << ARM_R3)), ctx);
+	emit(ARM_MOV_R(rd, ARM_IP), ctx);
+}
+
+static void ebpf_udivmod64(const u8 *rd, const u8 *rs, u8 op,
+			   struct jit_ctx *ctx)
+{
+	u32 func = op == BPF_DIV ? (u32)jit_udiv64 : (u32)jit_mod64;
+
+	emit(ARM_PUSH((1 << ARM_R0) | (1 << ARM_R1) |
+		      (1 << ARM_R2) | (1 << ARM_R3)), ctx);
+	emit(ARM_MOV_R(ARM_R10, rs[1]), ctx);
+	emit(ARM_MOV_R(ARM_LR, rs[0]), ctx);
+	if (rd[1] != ARM_R0) {
+		emit(ARM_MOV_R(ARM_R0, rd[1]), ctx);
+		emit(ARM_MOV_R(ARM_R1, rd[0]), ctx);
+	}
+	emit(ARM_MOV_R(ARM_R2, ARM_R10), ctx);
+	emit(ARM_MOV_R(ARM_R3, ARM_LR), ctx);
+	emit_mov_i(ARM_IP, func, ctx);
+	emit_blx_r(ARM_IP, ctx);
+	emit(ARM_MOV_R(ARM_R10, ARM_R0), ctx);
+	emit(ARM_MOV_R(ARM_IP, ARM_R1), ctx);
+	emit(ARM_POP((1 << ARM_R0) | (1 << ARM_R1) |
+		     (1 << ARM_R2) | (1 << ARM_R3)), ctx);
+	emit(ARM_MOV_R(rd[1], ARM_R10), ctx);
+	emit(ARM_MOV_R(rd[0], ARM_IP), ctx);
+}
+
+/* 32-bit ALU operation on the low words: rd = rd op rs. */
+static void ebpf_alu32(u8 rd, u8 rs, u8 op, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_ADD:
+		emit(ARM_ADD_R(rd, rd, rs), ctx);
+		break;
+	case BPF_SUB:
+		emit(ARM_SUB_R(rd, rd, rs), ctx);
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(rd, rd, rs), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_MUL:
+		emit(ARM_MUL(rd, rd, rs), ctx);
+		break;
+	case BPF_LSH:
+		emit(ARM_LSL_R(rd, rd, rs), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_LSR_R(rd, rd, rs), ctx);
+		break;
+	case BPF_ARSH:
+		emit(ARM_ASR_R(rd, rd, rs), ctx);
+		break;
+	}
+}
+
+/* 64-bit ALU operation: rd = rd op rs. */
+static void ebpf_alu64(const u8 *rd, const u8 *rs, u8 op, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_ADD:
+		emit(ARM_ADDS_R(rd[1], rd[1], rs[1]), ctx);
+		emit(ARM_ADC_R(rd[0], rd[0], rs[0]), ctx);
+		break;
+	case BPF_SUB:
+		emit(ARM_SUBS_R(rd[1], rd[1], rs[1]), ctx);
+		emit(ARM_SBC_R(rd[0], rd[0], rs[0]), ctx);
+		break;
+	case BPF_AND:
+		emit(ARM_AND_R(rd[1], rd[1], rs[1]), ctx);
+		emit(ARM_AND_R(rd[0], rd[0], rs[0]), ctx);
+		break;
+	case BPF_OR:
+		emit(ARM_ORR_R(rd[1], rd[1], rs[1]), ctx);
+		emit(ARM_ORR_R(rd[0], rd[0], rs[0]), ctx);
+		break;
+	case BPF_XOR:
+		emit(ARM_EOR_R(rd[1], rd[1], rs[1]), ctx);
+		emit(ARM_EOR_R(rd[0], rd[0], rs[0]), ctx);
+		break;
+	case BPF_MUL:
+		/* hi = lo(rd.hi * rs.lo + rd.lo * rs.hi) + hi(rd.lo * rs.lo) */
+		emit(ARM_MUL(ARM_IP, rd[0], rs[1]), ctx);
+		emit(ARM_MLA(ARM_IP, rd[1], rs[0], ARM_IP), ctx);
+		emit(ARM_UMULL(ARM_R10, ARM_LR, rd[1], rs[1]), ctx);
+		emit(ARM_ADD_R(rd[0], ARM_LR, ARM_IP), ctx);
+		emit(ARM_MOV_R(rd[1], ARM_R10), ctx);
+		break;
+	/*
+	 * Shifts by a register rely on ARM register shifts yielding 0 (or
+	 * the sign for asr) for amounts of 32 and up, which is also what
+	 * the low byte of a negative "n - 32" looks like.
+	 */
+	case BPF_LSH:
+		emit(ARM_SUB_I(ARM_IP, rs[1], 32), ctx);
+		emit(ARM_RSB_I(ARM_R10, rs[1], 32), ctx);
+		emit(ARM_LSL_R(ARM_LR, rd[0], rs[1]), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, rd[1], SRTYPE_LSL, ARM_IP), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, rd[1], SRTYPE_LSR, ARM_R10), ctx);
+		emit(ARM_LSL_R(rd[1], rd[1], rs[1]), ctx);
+		emit(ARM_MOV_R(rd[0], ARM_LR), ctx);
+		break;
+	case BPF_RSH:
+		emit(ARM_SUB_I(ARM_IP, rs[1], 32), ctx);
+		emit(ARM_RSB_I(ARM_R10, rs[1], 32), ctx);
+		emit(ARM_LSR_R(ARM_LR, rd[1], rs[1]), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, rd[0], SRTYPE_LSL, ARM_R10), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, rd[0], SRTYPE_LSR, ARM_IP), ctx);
+		emit(ARM_LSR_R(rd[0], rd[0], rs[1]), ctx);
+		emit(ARM_MOV_R(rd[1], ARM_LR), ctx);
+		break;
+	case BPF_ARSH:
+		emit(ARM_RSB_I(ARM_R10, rs[1], 32), ctx);
+		emit(ARM_SUBS_I(ARM_IP, rs[1], 32), ctx);
+		emit(ARM_LSR_R(ARM_LR, rd[1], rs[1]), ctx);
+		emit(ARM_ORR_SR(ARM_LR, ARM_LR, rd[0], SRTYPE_LSL, ARM_R10), ctx);
+		_emit(ARM_COND_PL,
+		      ARM_ORR_SR(ARM_LR, ARM_LR, rd[0], SRTYPE_ASR, ARM_IP), ctx);
+		emit(ARM_ASR_R(rd[0], rd[0], rs[1]), ctx);
+		emit(ARM_MOV_R(rd[1], ARM_LR), ctx);
+		break;
+	}
+}
+
+/* 64-bit shift of rd by the constant 0 < k < 64. */
+static void ebpf_shift64_i(const u8 *rd, u32 k, u8 op, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_LSH:
+		if (k < 32) {
+			emit(ARM_LSL_I(rd[0], rd[0], k), ctx);
+			emit(ARM_ORR_S(rd[0], rd[0], rd[1], SRTYPE_LSR, 32 - k),
+			     ctx);
+			emit(ARM_LSL_I(rd[1], rd[1], k), ctx);
+		} else {
+			emit(ARM_LSL_I(rd[0], rd[1], k - 32), ctx);
+			emit(ARM_MOV_I(rd[1], 0), ctx);
+		}
+		break;
+	case BPF_RSH:
+		if (k < 32) {
+			emit(ARM_LSR_I(rd[1], rd[1], k), ctx);
+			emit(ARM_ORR_S(rd[1], rd[1], rd[0], SRTYPE_LSL, 32 - k),
+			     ctx);
+			emit(ARM_LSR_I(rd[0], rd[0], k), ctx);
+		} else {
+			if (k == 32)
+				emit(ARM_MOV_R(rd[1], rd[0]), ctx);
+			else
+				emit(ARM_LSR_I(rd[1], rd[0], k - 32), ctx);
+			emit(ARM_MOV_I(rd[0], 0), ctx);
+		}
+		break;
+	case BPF_ARSH:
+		if (k < 32) {
+			emit(ARM_LSR_I(rd[1], rd[1], k), ctx);
+			emit(ARM_ORR_S(rd[1], rd[1], rd[0], SRTYPE_LSL, 32 - k),
+			     ctx);
+			emit(ARM_ASR_I(rd[0], rd[0], k), ctx);
+		} else {
+			if (k == 32)
+				emit(ARM_MOV_R(rd[1], rd[0]), ctx);
+			else
+				emit(ARM_ASR_I(rd[1], rd[0], k - 32), ctx);
+			emit(ARM_ASR_I(rd[0], rd[0], 31), ctx);
+		}
+		break;
+	}
+}
+
+/*
+ * Compare rd with rs for the conditional jump @op and return the ARM
+ * condition under which the jump is taken.
+ */
+static u8 ebpf_cmp64(const u8 *rd, const u8 *rs, u8 op, struct jit_ctx *ctx)
+{
+	switch (op) {
+	case BPF_JSET:
+		emit(ARM_TST_R(rd[0], rs[0]), ctx);
+		_emit(ARM_COND_EQ, ARM_TST_R(rd[1], rs[1]), ctx);
+		return ARM_COND_NE;
+	case BPF_JSGT:
+		/* rd > rs  <=>  rs - rd < 0 */
+		emit(ARM_SUBS_R(ARM_IP, rs[1], rd[1]), ctx);
+		emit(ARM_SBCS_R(ARM_IP, rs[0], rd[0]), ctx);
+		return ARM_COND_LT;
+	case BPF_JSGE:
+		emit(ARM_SUBS_R(ARM_IP, rd[1], rs[1]), ctx);
+		emit(ARM_SBCS_R(ARM_IP, rd[0], rs[0]), ctx);
+		return ARM_COND_GE;
+	}
+
+	emit(ARM_CMP_R(rd[0], rs[0]), ctx);
+	_emit(ARM_COND_EQ, ARM_CMP_R(rd[1], rs[1]), ctx);
+
+	switch (op) {
+	case BPF_JEQ:
+		return ARM_COND_EQ;
+	case BPF_JNE:
+		return ARM_COND_NE;
+	case BPF_JGT:
+		return ARM_COND_HI;
+	default:	/* BPF_JGE */
+		return ARM_COND_CS;
+	}
+}
+
+/*
+ * Tail call: jump into the target program right after its prologue,
+ * reusing the current stack frame. Everything is predicated so the
+ * sequence has no forward branches:
+ *
+ *	if (index >= array->map.max_entries ||
+ *	    tail_call_cnt > MAX_TAIL_CALL_CNT)
+ *		prog = NULL;
+ *	else
+ *		prog = array->ptrs[index], tail_call_cnt++;
+ *	if (prog)
+ *		goto *(prog->bpf_func + prologue_bytes);
+ */
+static void ebpf_tail_call(struct jit_ctx *ctx)
+{
+	const s16 *r2 = bpf2a32[BPF_REG_2];
+	const s16 *r3 = bpf2a32[BPF_REG_3];
+	u32 off;
+
+	BUILD_BUG_ON(offsetof(struct bpf_array, map.max_entries) > 0xfff);
+	BUILD_BUG_ON(offsetof(struct bpf_array, ptrs) > 0xfff);
+	BUILD_BUG_ON(offsetof(struct bpf_prog, bpf_func) > 0xfff);
+
+	emit(ARM_LDR_I(ARM_R6, ARM_SP, STACK_OFF(r2[1])), ctx);
+	emit(ARM_LDR_I(ARM_R7, ARM_SP, STACK_OFF(r3[1])), ctx);
+	off = offsetof(struct bpf_array, map.max_entries);
+	emit(ARM_LDR_I(ARM_R8, ARM_R6, off), ctx);
+	emit(ARM_LDR_I(ARM_R9, ARM_SP, BPF_TC_LO * 4), ctx);
+
+	emit(ARM_CMP_R(ARM_R7, ARM_R8), ctx);
+	_emit(ARM_COND_CC, ARM_CMP_I(ARM_R9, MAX_TAIL_CALL_CNT + 1), ctx);
+
+	_emit(ARM_COND_CC, ARM_ADD_I(ARM_R9, ARM_R9, 1), ctx);
+	_emit(ARM_COND_CC, ARM_STR_I(ARM_R9, ARM_SP, BPF_TC_LO * 4), ctx);
+	_emit(ARM_COND_CC, ARM_ADD_SI(ARM_R6, ARM_R6, ARM_R7, SRTYPE_LSL, 2),
+	      ctx);
+	off = offsetof(struct bpf_array, ptrs);
+	_emit(ARM_COND_CC, ARM_LDR_I(ARM_R6, ARM_R6, off), ctx);
+	_emit(ARM_COND_CS, ARM_MOV_I(ARM_R6, 0), ctx);
+
+	emit(ARM_CMP_I(ARM_R6, 0), ctx);
+	off = offsetof(struct bpf_prog, bpf_func);
+	_emit(ARM_COND_NE, ARM_LDR_I(ARM_R6, ARM_R6, off), ctx);
+	/* the prologue is a handful of instructions, always an imm8m */
+	_emit(ARM_COND_NE, ARM_ADD_I(ARM_R6, ARM_R6, ctx->prologue_bytes),
+	      ctx);
+	_emit(ARM_COND_NE, ARM_BX(ARM_R6), ctx);
+}
+
+/* LD_ABS and LD_IND, through the same helpers as the classic JIT. */
+static void ebpf_ld_skb(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const s16 *src = bpf2a32[insn->src_reg];
+	u32 func;
+	u8 rs;
+
+	switch (BPF_SIZE(insn->code)) {
+	case BPF_B:
+		func = (u32)jit_get_skb_b;
+		break;
+	case BPF_H:
+		func = (u32)jit_get_skb_h;
+		break;
+	default:
+		func = (u32)jit_get_skb_w;
+		break;
+	}
+
+	if (BPF_MODE(insn->code) == BPF_IND) {
+		rs = ebpf_get_lo(src, tmp2[1], ctx);
+		emit_mov_i(ARM_IP, insn->imm, ctx);
+		emit(ARM_ADD_R(ARM_R1, rs, ARM_IP), ctx);
+	} else {
+		emit_mov_i(ARM_R1, insn->imm, ctx);
+	}
+	/* the skb is in R6 */
+	emit(ARM_MOV_R(ARM_R0, bpf2a32[BPF_REG_6][1]), ctx);
+	emit_mov_i(ARM_IP, func, ctx);
+	emit_blx_r(ARM_IP, ctx);
+
+	/* the error code comes back in the high word, which is R0 hi */
+	emit(ARM_CMP_I(ARM_R1, 0), ctx);
+	ebpf_exit_if(ARM_COND_NE, ctx);
+}
+
+/*
+ * Translate one eBPF instruction. Returns 1 if the instruction took two
+ * slots (BPF_LD | BPF_IMM | BPF_DW), 0 on success and < 0 if it cannot
+ * be JITed.
+ */
+static int build_ebpf_insn(const struct bpf_insn *insn, struct jit_ctx *ctx)
+{
+	const u8 code = insn->code;
+	const u8 op = BPF_OP(code);
+	const s16 *dst = bpf2a32[insn->dst_reg];
+	const s16 *src = bpf2a32[insn->src_reg];
+	const int i = insn - ctx->skf->insnsi;
+	const s32 imm = insn->imm;
+	const s16 off = insn->off;
+	u8 rd[2], rs[2];
+	u8 cond;
+
+	switch (code) {
+	/* dst = src */
+	case BPF_ALU | BPF_MOV | BPF_X:
+		rs[1] = ebpf_get_lo(src, tmp2[1], ctx);
+		ebpf_put_reg32(dst, rs[1], ctx);
+		break;
+	case BPF_ALU64 | BPF_MOV | BPF_X:
+		ebpf_get_reg64(src, tmp2, rs, ctx);
+		ebpf_put_reg64(dst, rs, ctx);
+		break;
+	/* dst = imm */
+	case BPF_ALU | BPF_MOV | BPF_K:
+		rd[1] = is_stacked(dst[1]) ? tmp1[1] : dst[1];
+		emit_mov_i(rd[1], imm, ctx);
+		ebpf_put_reg32(dst, rd[1], ctx);
+		break;
+	case BPF_ALU64 | BPF_MOV | BPF_K:
+		if (is_stacked(dst[1])) {
+			rd[0] = tmp1[0];
+			rd[1] = tmp1[1];
+		} else {
+			rd[0] = dst[0];
+			rd[1] = dst[1];
+		}
+		ebpf_mov_i64(rd, imm, ctx);
+		ebpf_put_reg64(dst, rd, ctx);
+		break;
+	/* dst = dst OP src/imm */
+	case BPF_ALU | BPF_ADD | BPF_X:
+	case BPF_ALU | BPF_ADD | BPF_K:
+	case BPF_ALU | BPF_SUB | BPF_X:
+	case BPF_ALU | BPF_SUB | BPF_K:
+	case BPF_ALU | BPF_AND | BPF_X:
+	case BPF_ALU | BPF_AND | BPF_K:
+	case BPF_ALU | BPF_OR | BPF_X:
+	case BPF_ALU | BPF_OR | BPF_K:
+	case BPF_ALU | BPF_XOR | BPF_X:
+	case BPF_ALU | BPF_XOR | BPF_K:
+	case BPF_ALU | BPF_MUL | BPF_X:
+	case BPF_ALU | BPF_MUL | BPF_K:
+	case BPF_ALU | BPF_LSH | BPF_X:
+	case BPF_ALU | BPF_RSH | BPF_X:
+	case BPF_ALU | BPF_ARSH | BPF_X:
+		if (BPF_SRC(code) == BPF_K) {
+			rs[1] = tmp2[1];
+			emit_mov_i(rs[1], imm, ctx);
+		} else {
+			rs[1] = ebpf_get_lo(src, tmp2[1], ctx);
+		}
+		rd[1] = ebpf_get_lo(dst, tmp1[1], ctx);
+		ebpf_alu32(rd[1], rs[1], op, ctx);
+		ebpf_put_reg32(dst, rd[1], ctx);
+		break;
+	case BPF_ALU64 | BPF_ADD | BPF_X:
+	case BPF_ALU64 | BPF_ADD | BPF_K:
+	case BPF_ALU64 | BPF_SUB | BPF_X:
+	case BPF_ALU64 | BPF_SUB | BPF_K:
+	case BPF_ALU64 | BPF_AND | BPF_X:
+	case BPF_ALU64 | BPF_AND | BPF_K:
+	case BPF_ALU64 | BPF_OR | BPF_X:
+	case BPF_ALU64 | BPF_OR | BPF_K:
+	case BPF_ALU64 | BPF_XOR | BPF_X:
+	case BPF_ALU64 | BPF_XOR | BPF_K:
+	case BPF_ALU64 | BPF_MUL | BPF_X:
+	case BPF_ALU64 | BPF_MUL | BPF_K:
+	case BPF_ALU64 | BPF_LSH | BPF_X:
+	case BPF_ALU64 | BPF_RSH | BPF_X:
+	case BPF_ALU64 | BPF_ARSH | BPF_X:
+		if (BPF_SRC(code) == BPF_K) {
+			rs[0] = tmp2[0];
+			rs[1] = tmp2[1];
+			ebpf_mov_i64(rs, imm, ctx);
+		} else {
+			ebpf_get_reg64(src, tmp2, rs, ctx);
+		}
+		ebpf_get_reg64(dst, tmp1, rd, ctx);
+		ebpf_alu64(rd, rs, op, ctx);
+		ebpf_put_reg64(dst, rd, ctx);
+		break;
+	/* dst = dst << / >> imm */
+	case BPF_ALU | BPF_LSH | BPF_K:
+	case BPF_ALU | BPF_RSH | BPF_K:
+	case BPF_ALU | BPF_ARSH | BPF_K:
+		if (unlikely(imm < 0 || imm > 31))
+			return -EINVAL;
+		rd[1] = ebpf_get_lo(dst, tmp1[1], ctx);
+		if (imm) {
+			if (op == BPF_LSH)
+				emit(ARM_LSL_I(rd[1], rd[1], imm), ctx);
+			else if (op == BPF_RSH)
+				emit(ARM_LSR_I(rd[1], rd[1], imm), ctx);
+			else
+				emit(ARM_ASR_I(rd[1], rd[1], imm), ctx);
+		}
+		ebpf_put_reg32(dst, rd[1], ctx);
+		break;
+	case BPF_ALU64 | BPF_LSH | BPF_K:
+	case BPF_ALU64 | BPF_RSH | BPF_K:
+	case BPF_ALU64 | BPF_ARSH | BPF_K:
+		if (unlikely(imm < 0 || imm > 63))
+			return -EINVAL;
+		if (!imm)
+			break;
+		ebpf_get_reg64(dst, tmp1, rd, ctx);
+		ebpf_shift64_i(rd, imm, op, ctx);
+		ebpf_put_reg64(dst, rd, ctx);
+		break;
+	/* dst = dst / src, dst = dst % src */
+	case BPF_ALU | BPF_DIV | BPF_X:
+	case BPF_ALU | BPF_DIV | BPF_K:
+	case BPF_ALU | BPF_MOD | BPF_X:
+	case BPF_ALU | BPF_MOD | BPF_K:
+		if (BPF_SRC(code) == BPF_K) {
+			if (!imm)
+				return -EINVAL;
+			rs[1] = tmp2[1];
+			emit_mov_i(rs[1], imm, ctx);
+		} else {
+			rs[1] = ebpf_get_lo(src, tmp2[1], ctx);
+			emit(ARM_CMP_I(rs[1], 0), ctx);
+			ebpf_exit_if(ARM_COND_EQ, ctx);
+		}
+		rd[1] = ebpf_get_lo(dst, tmp1[1], ctx);
+		ebpf_udivmod32(rd[1], rs[1], op, ctx);
+		ebpf_put_reg32(dst, rd[1], ctx);
+		break;
+	case BPF_ALU64 | BPF_DIV | BPF_X:
+	case BPF_ALU64 | BPF_DIV | BPF_K:
+	case BPF_ALU64 | BPF_MOD | BPF_X:
+	case BPF_ALU64 | BPF_MOD | BPF_K:
+		if (BPF_SRC(code) == BPF_K) {
+			if (!imm)
+				return -EINVAL;
+			rs[0] = tmp2[0];
+			rs[1] = tmp2[1];
+			ebpf_mov_i64(rs, imm, ctx);
+		} else {
+			ebpf_get_reg64(src, tmp2, rs, ctx);
+			emit(ARM_CMP_I(rs[1], 0), ctx);
+			_emit(ARM_COND_EQ, ARM_CMP_I(rs[0], 0), ctx);
+			ebpf_exit_if(ARM_COND_EQ, ctx);
+		}
+		ebpf_get_reg64(dst, tmp1, rd, ctx);
+		ebpf_udivmod64(rd, rs, op, ctx);
+		ebpf_put_reg64(dst, rd, ctx);
+		break;
+	/* dst = -dst */
+	case BPF_ALU | BPF_NEG:
+		rd[1] = ebpf_get_lo(dst, tmp1[1], ctx);
+		emit(ARM_RSB_I(rd[1], rd[1], 0), ctx);
+		ebpf_put_reg32(dst, rd[1], ctx);
+		break;
+	case BPF_ALU64 | BPF_NEG:
+		ebpf_get_reg64(dst, tmp1, rd, ctx);
+		emit(ARM_RSBS_I(rd[1], rd[1], 0), ctx);
+		emit(ARM_RSC_I(rd[0], rd[0], 0), ctx);
+		ebpf_put_reg64(dst, rd, ctx);
+		break;
+	/* dst = BSWAP##imm(dst) */
+	case BPF_ALU | BPF_END | BPF_FROM_LE:
+	case BPF_ALU | BPF_END | BPF_FROM_BE:
+		ebpf_get_reg64(dst, tmp1, rd, ctx);
+		switch (imm) {
+		case 16:
+			if (BPF_SRC(code) == BPF_FROM_BE)
+				emit(ARM_REV16(rd[1], rd[1]), ctx);
+			emit(ARM_UXTH(rd[1], rd[1]), ctx);
+			ebpf_put_reg32(dst, rd[1], ctx);
+			break;
+		case 32:
+			if (BPF_SRC(code) == BPF_FROM_BE)
+				emit(ARM_REV(rd[1], rd[1]), ctx);
+			ebpf_put_reg32(dst, rd[1], ctx);
+			break;
+		case 64:
+			if (BPF_SRC(code) == BPF_FROM_LE)
+				break;
+			emit(ARM_REV(ARM_IP, rd[1]), ctx);
+			emit(ARM_REV(rd[1], rd[0]), ctx);
+			emit(ARM_MOV_R(rd[0], ARM_IP), ctx);
+			ebpf_put_reg64(dst, rd, ctx);
+			break;
+		default:
+			return -EINVAL;
+		}
+		break;
+
+	/* JUMP off */
+	case BPF_JMP | BPF_JA:
+		emit(ARM_B(ebpf_b_imm(ctx->offsets[i + off + 1], ctx)), ctx);
+		break;
+	/* IF (dst COND src/imm) JUMP off */
+	case BPF_JMP | BPF_JEQ | BPF_X:
+	case BPF_JMP | BPF_JEQ | BPF_K:
+	case BPF_JMP | BPF_JNE | BPF_X:
+	case BPF_JMP | BPF_JNE | BPF_K:
+	case BPF_JMP | BPF_JGT | BPF_X:
+	case BPF_JMP | BPF_JGT | BPF_K:
+	case BPF_JMP | BPF_JGE | BPF_X:
+	case BPF_JMP | BPF_JGE | BPF_K:
+	case BPF_JMP | BPF_JSGT | BPF_X:
+	case BPF_JMP | BPF_JSGT | BPF_K:
+	case BPF_JMP | BPF_JSGE | BPF_X:
+	case BPF_JMP | BPF_JSGE | BPF_K:
+	case BPF_JMP | BPF_JSET | BPF_X:
+	case BPF_JMP | BPF_JSET | BPF_K:
+		if (BPF_SRC(code) == BPF_K) {
+			rs[0] = tmp2[0];
+			rs[1] = tmp2[1];
+			ebpf_mov_i64(rs, imm, ctx);
+		} else {
+			ebpf_get_reg64(src, tmp2, rs, ctx);
+		}
+		ebpf_get_reg64(dst, tmp1, rd, ctx);
+		cond = ebpf_cmp64(rd, rs, op, ctx);
+		_emit(cond, ARM_B(ebpf_b_imm(ctx->offsets[i + off + 1], ctx)),
+		      ctx);
+		break;
+	/* function call */
+	case BPF_JMP | BPF_CALL:
+		ebpf_call((u32)__bpf_call_base + imm, ctx);
+		break;
+	/* tail call */
+	case BPF_JMP | BPF_CALL | BPF_X:
+		ebpf_tail_call(ctx);
+		break;
+	/* function return */
+	case BPF_JMP | BPF_EXIT:
+		/* the epilogue directly follows the last instruction */
+		if (i == ctx->skf->len - 1)
+			break;
+		emit(ARM_B(ebpf_b_imm(ctx->epilogue_offset, ctx)), ctx);
+		break;
+
+	/* dst = imm64 */
+	case BPF_LD | BPF_IMM | BPF_DW:
+		if (is_stacked(dst[1])) {
+			rd[0] = tmp1[0];
+			rd[1] = tmp1[1];
+		} else {
+			rd[0] = dst[0];
+			rd[1] = dst[1];
+		}
+		emit_mov_i(rd[1], (u32)insn[0].imm, ctx);
+		emit_mov_i(rd[0], (u32)insn[1].imm, ctx);
+		ebpf_put_reg64(dst, rd, ctx);
+		return 1;
+
+	/* LDX: dst = *(size *)(src + off) */
+	case BPF_LDX | BPF_MEM | BPF_W:
+	case BPF_LDX | BPF_MEM | BPF_H:
+	case BPF_LDX | BPF_MEM | BPF_B:
+		rs[1] = ebpf_get_lo(src, tmp2[1], ctx);
+		rd[1] = is_stacked(dst[1]) ? tmp1[1] : dst[1];
+		ebpf_ldst(true, BPF_SIZE(code), rd[1], rs[1], off, ctx);
+		ebpf_put_reg32(dst, rd[1], ctx);
+		break;
+	case BPF_LDX | BPF_MEM | BPF_DW:
+		rs[1] = ebpf_get_lo(src, tmp2[1], ctx);
+		if (is_stacked(dst[1])) {
+			rd[0] = tmp1[0];
+			rd[1] = tmp1[1];
+		} else {
+			rd[0] = dst[0];
+			rd[1] = dst[1];
+		}
+		/* the base may be the low word of dst, load it last */
+		ebpf_ldst(true, BPF_W, rd[0], rs[1], off + 4, ctx);
+		ebpf_ldst(true, BPF_W, rd[1], rs[1], off, ctx);
+		ebpf_put_reg64(dst, rd, ctx);
+		break;
+
+	/* ST: *(size *)(dst + off) = imm */
+	case BPF_ST | BPF_MEM | BPF_W:
+	case BPF_ST | BPF_MEM | BPF_H:
+	case BPF_ST | BPF_MEM | BPF_B:
+	case BPF_ST | BPF_MEM | BPF_DW:
+		rs[0] = tmp2[0];
+		rs[1] = tmp2[1];
+		ebpf_mov_i64(rs, imm, ctx);
+		goto emit_store;
+	/* STX: *(size *)(dst + off) = src */
+	case BPF_STX | BPF_MEM | BPF_W:
+	case BPF_STX | BPF_MEM | BPF_H:
+	case BPF_STX | BPF_MEM | BPF_B:
+	case BPF_STX | BPF_MEM | BPF_DW:
+		ebpf_get_reg64(src, tmp2, rs, ctx);
+emit_store:
+		rd[1] = ebpf_get_lo(dst, tmp1[1], ctx);
+		if (BPF_SIZE(code) == BPF_DW) {
+			ebpf_ldst(false, BPF_W, rs[1], rd[1], off, ctx);
+			ebpf_ldst(false, BPF_W, rs[0], rd[1], off + 4, ctx);
+		} else {
+			ebpf_ldst(false, BPF_SIZE(code), rs[1], rd[1], off, ctx);
+		}
+		break;
+	/* STX XADD: lock *(u32 *)(dst + off) += src */
+	case BPF_STX | BPF_XADD | BPF_W:
+	case BPF_STX | BPF_XADD | BPF_DW:
+		ebpf_get_reg64(src, tmp2, rs, ctx);
+		rd[1] = ebpf_get_lo(dst, tmp1[1], ctx);
+		emit_mov_i(ARM_IP, off, ctx);
+		emit(ARM_ADD_R(ARM_R10, rd[1], ARM_IP), ctx);
+		if (BPF_SIZE(code) == BPF_W) {
+			emit(ARM_LDREX(ARM_LR, ARM_R10), ctx);
+			emit(ARM_ADD_R(ARM_LR, ARM_LR, rs[1]), ctx);
+			emit(ARM_STREX(ARM_IP, ARM_LR, ARM_R10), ctx);
+		} else {
+			/* ldrexd/strexd need an even/odd pair: r6/r7 */
+			emit(ARM_LDREXD(ARM_R6, ARM_R10), ctx);
+			emit(ARM_ADDS_R(ARM_R6, ARM_R6, rs[1]), ctx);
+			emit(ARM_ADC_R(ARM_R7, ARM_R7, rs[0]), ctx);
+			emit(ARM_STREXD(ARM_IP, ARM_R6, ARM_R10), ctx);
+		}
+		emit(ARM_CMP_I(ARM_IP, 0), ctx);
+		/* retry from the exclusive load */
+		_emit(ARM_COND_NE, ARM_B(ebpf_b_imm(ctx->idx -
+				(BPF_SIZE(code) == BPF_W ? 4 : 5), ctx)), ctx);
+		break;
+
+	/* R0 = ntohx(*(size *)(((struct sk_buff *)R6)->data + imm)) */
+	case BPF_LD | BPF_ABS | BPF_W:
+	case BPF_LD | BPF_ABS | BPF_H:
+	case BPF_LD | BPF_ABS | BPF_B:
+	/* R0 = ntohx(*(size *)(((struct sk_buff *)R6)->data + src + imm)) */
+	case BPF_LD | BPF_IND | BPF_W:
+	case BPF_LD | BPF_IND | BPF_H:
+	case BPF_LD | BPF_IND | BPF_B:
+		ebpf_ld_skb(insn, ctx);
+		break;
+
+	default:
+		pr_err_once("unknown opcode %02x\n", code);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int build_ebpf_body(struct jit_ctx *ctx)
+{
+	const struct bpf_prog *prog = ctx->skf;
+	int i;
+
+	for (i = 0; i < prog->len; i++) {
+		const struct bpf_insn *insn = &prog->insnsi[i];
+		int ret;
+
+		/* offsets are only computed during the first pass */
+		if (ctx->target == NULL)
+			ctx->offsets[i] = ctx->idx;
+
+		ret = build_ebpf_insn(insn, ctx);
+		if (ret > 0) {
+			i++;
+			if (ctx->target == NULL)
+				ctx->offsets[i] = ctx->idx;
+			continue;
+		}
+		if (ret)
+			return ret;
+	}
+
+	if (ctx->target == NULL)
+		ctx->offsets[i] = ctx->idx;
+
+	return 0;
+}
+
+/*
+ * The prologue is the same for every program, so that a tail call can
+ * enter another program right after it.
+ */
+static void build_ebpf_prologue(struct jit_ctx *ctx)
+{
+	const s16 *r1 = bpf2a32[BPF_REG_1];
+	unsigned start = ctx->idx;
+	int imm12;
+
+	emit(ARM_PUSH(EBPF_SAVED_REGS | (1 << ARM_LR)), ctx);
+
+	imm12 = imm8m(EBPF_STACK_SIZE);
+	if (imm12 >= 0) {
+		emit(ARM_SUB_I(ARM_SP, ARM_SP, imm12), ctx);
+		emit(ARM_ADD_I(ARM_IP, ARM_SP, imm12), ctx);
+	} else {
+		emit_mov_i_no8m(ARM_IP, EBPF_STACK_SIZE, ctx);
+		emit(ARM_SUB_R(ARM_SP, ARM_SP, ARM_IP), ctx);
+		emit(ARM_ADD_R(ARM_IP, ARM_SP, ARM_IP), ctx);
+	}
+
+	/* FP points to the top of the program stack */
+	emit(ARM_STR_I(ARM_IP, ARM_SP, BPF_FP_LO * 4), ctx);
+	emit(ARM_MOV_I(ARM_IP, 0), ctx);
+	emit(ARM_STR_I(ARM_IP, ARM_SP, BPF_FP_HI * 4), ctx);
+	emit(ARM_STR_I(ARM_IP, ARM_SP, BPF_TC_LO * 4), ctx);
+	emit(ARM_STR_I(ARM_IP, ARM_SP, BPF_TC_HI * 4), ctx);
+
+	/* R1 = ctx */
+	emit(ARM_MOV_R(r1[1], ARM_R0), ctx);
+	emit(ARM_MOV_I(r1[0], 0), ctx);
+
+	ctx->prologue_bytes = (ctx->idx - start) * 4;
+}
+
+static void build_ebpf_epilogue(struct jit_ctx *ctx)
+{
+	int imm12 = imm8m(EBPF_STACK_SIZE);
+
+	/* the return value is the low word of R0, already in r0 */
+	if (imm12 >= 0) {
+		emit(ARM_ADD_I(ARM_SP, ARM_SP, imm12), ctx);
+	} else {
+		emit_mov_i_no8m(ARM_IP, EBPF_STACK_SIZE, ctx);
+		emit(ARM_ADD_R(ARM_SP, ARM_SP, ARM_IP), ctx);
+	}
+	emit(ARM_POP(EBPF_SAVED_REGS | (1 << ARM_PC)), ctx);
+}
+
+void bpf_int_jit_compile(struct bpf_prog *prog)
+{
+	struct bpf_binary_header *header;
+	struct jit_ctx ctx;
+	unsigned alloc_size;
+	u8 *target_ptr;
+
+	if (!bpf_jit_enable)
+		return;
+
+	if (!prog || !prog->len)
+		return;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.skf = prog;
+
+	ctx.offsets = kcalloc(prog->len + 1, sizeof(u32), GFP_KERNEL);
+	if (ctx.offsets == NULL)
+		return;
+
+	/* fake pass to fill in the offsets and the image size */
+	build_ebpf_prologue(&ctx);
+	if (build_ebpf_body(&ctx))
+		goto out;
+	ctx.epilogue_offset = ctx.idx;
+	build_ebpf_epilogue(&ctx);
+
+	alloc_size = 4 * ctx.idx;
+	header = bpf_jit_binary_alloc(alloc_size, &target_ptr,
+				      4, jit_fill_hole);
+	if (header == NULL)
+		goto out;
+
+	ctx.target = (u32 *) target_ptr;
+	ctx.idx = 0;
+
+	build_ebpf_prologue(&ctx);
+	if (build_ebpf_body(&ctx)) {
+		bpf_jit_binary_free(header);
+		goto out;
+	}
+	build_ebpf_epilogue(&ctx);
+
+	flush_icache_range((u32)header, (u32)(ctx.target + ctx.idx));
+
+	if (bpf_jit_enable > 1)
+		/* there are 2 passes here */
+		bpf_jit_dump(prog->len, alloc_size, 2, ctx.target);
+
+	set_memory_ro((unsigned long)header, header->pages);
+	prog->bpf_func = (void *)ctx.target;
+	prog->jited = 1;
+out:
+	kfree(ctx.offsets);
+}
+
+#endif /* CONFIG_ARM_EBPF_JIT && __LINUX_ARM_ARCH__ >= 7 */
+
 void bpf_jit_free(struct bpf_prog *fp)
 {
 	unsigned long addr = (unsigned long)fp->bpf_func & PAGE_MASK;
@@ -0,0 +1,601 @@
+/*
+ * buffered writeback throttling. loosely based on CoDel. We can't drop
+ * packets for IO scheduling, so the logic is something like this:
+ *
+ * - Monitor read completion latencies in a fixed window of time.
+ * - If the minimum latency in the window exceeds the target, step down
+ *   the allowed queue depth for buffered writes.
+ * - If the minimum latency stays below the target, step the depth back
+ *   up again.
+ * - The window shrinks with the square root of the scale step while we
+ *   are throttling, so we react faster when the device is in trouble.
+ *
+ * Only buffered writes issued by writeback are throttled; reads, O_DIRECT
+ * writes, discards and flushes always pass straight through.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/ktime.h>
+#include <linux/swap.h>
+
+#include "blk-wbt.h"
+
+#define RWB_DEF_DEPTH		16
+#define RWB_WINDOW_NSEC		(100 * 1000 * 1000ULL)
+#define RWB_MIN_READ_SAMPLES	1
+#define RWB_UNKNOWN_BUMP	5
+
+/*
+ * Default read latency targets, in nsecs
+ */
+#define RWB_DEF_LAT_NONROT	(2 * 1000 * 1000ULL)
+#define RWB_DEF_LAT_ROT		(75 * 1000 * 1000ULL)
+
+enum {
+	LAT_OK = 1,
+	LAT_UNKNOWN,
+	LAT_UNKNOWN_WRITES,
+	LAT_EXCEEDED,
+};
+
+static inline bool rwb_enabled(struct rq_wb *rwb)
+{
+	return rwb && rwb->wb_normal != 0;
+}
+
+/*
+ * Increment 'v', if 'v' is below 'below'. Returns true if we succeeded,
+ * false if 'v' + 1 would be bigger than 'below'.
+ */
+static bool atomic_inc_below(atomic_t *v, int below)
+{
+	int cur = atomic_read(v);
+
+	for (;;) {
+		int old;
+
+		if (cur >= below)
+			return false;
+		old = atomic_cmpxchg(v, cur, cur + 1);
+		if (old == cur)
+			break;
+		cur = old;
+	}
+
+	return true;
+}
+
+static void wb_timestamp(struct rq_wb *rwb, unsigned long *var)
+{
+	if (rwb_enabled(rwb)) {
+		const unsigned long cur = jiffies;
+
+		if (cur != *var)
+			*var = cur;
+	}
+}
+
+static void rwb_wake_all(struct rq_wb *rwb)
+{
+	if (waitqueue_active(&rwb->wait))
+		wake_up_all(&rwb->wait);
+}
+
+void __wbt_done(struct rq_wb *rwb, unsigned int wb_acct)
+{
+	int inflight, limit;
+
+	if (!(wb_acct & WBT_TRACKED))
+		return;
+
+	inflight = atomic_dec_return(&rwb->inflight);
+
+	/*
+	 * wbt got disabled with IO in flight. Wake up any potential
+	 * waiters, we don't have to do more than that.
+	 */
+	if (unlikely(!rwb_enabled(rwb))) {
+		rwb_wake_all(rwb);
+		return;
+	}
+
+	/*
+	 * kswapd was allowed the full depth, everyone else is woken up
+	 * against the normal limit.
+	 */
+	if (wb_acct & WBT_KSWAPD)
+		limit = rwb->wb_max;
+	else
+		limit = rwb->wb_normal;
+
+	/*
+	 * Don't wake anyone up if we are above the normal limit.
+	 */
+	if (inflight && inflight >= limit)
+		return;
+
+	if (waitqueue_active(&rwb->wait)) {
+		int diff = limit - inflight;
+
+		if (!inflight || diff >= rwb->wb_background / 2)
+			wake_up(&rwb->wait);
+	}
+}
+
+static void wbt_add_read_sample(struct rq_wb *rwb, u64 lat)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rwb->stat_lock, flags);
+	if (!rwb->read_samples || lat < rwb->read_min_nsec)
+		rwb->read_min_nsec = lat;
+	rwb->read_samples++;
+	spin_unlock_irqrestore(&rwb->stat_lock, flags);
+}
+
+/*
+ * Called on completion of a request. Note that it's also called when
+ * a request is merged, when the request gets freed.
+ */
+void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+	if (!rwb)
+		return;
+
+	if (rq->wbt_flags & WBT_TRACKED) {
+		__wbt_done(rwb, rq->wbt_flags);
+		if (rq->wbt_issue_ns) {
+			unsigned long flags;
+
+			spin_lock_irqsave(&rwb->stat_lock, flags);
+			rwb->write_samples++;
+			spin_unlock_irqrestore(&rwb->stat_lock, flags);
+		}
+	} else if (rq->wbt_flags & WBT_READ) {
+		wbt_add_read_sample(rwb, ktime_get_ns() - rq->wbt_issue_ns);
+		wb_timestamp(rwb, &rwb->last_comp);
+	}
+
+	wbt_clear_state(rq);
+}
+
+/*
+ * Returns true if other (non-throttled) IO was issued or completed in the
+ * last 100msec.
+ */
+static bool close_io(struct rq_wb *rwb)
+{
+	const unsigned long now = jiffies;
+
+	return time_before(now, rwb->last_issue + HZ / 10) ||
+		time_before(now, rwb->last_comp + HZ / 10);
+}
+
+/*
+ * Return how many requests we allow in flight for a write of type @rw.
+ * kswapd gets the full depth, since it is trying to free memory; plain
+ * background writeback only gets a quarter of it, as does everyone when
+ * other IO is going on.
+ */
+static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw)
+{
+	unsigned int limit;
+
+	if (current_is_kswapd())
+		limit = rwb->wb_max;
+	else if (!(rw & REQ_SYNC) || close_io(rwb))
+		limit = rwb->wb_background;
+	else
+		limit = rwb->wb_normal;
+
+	return limit;
+}
+
+static inline bool may_queue(struct rq_wb *rwb, wait_queue_t *wait,
+			     unsigned long rw)
+{
+	/*
+	 * inc it here even if disabled, since we'll dec it at completion.
+	 * this only happens if the task was sleeping in __wbt_wait(),
+	 * and someone turned it off at the same time.
+	 */
+	if (!rwb_enabled(rwb)) {
+		atomic_inc(&rwb->inflight);
+		return true;
+	}
+
+	/*
+	 * If the waitqueue is already active and we are not the next
+	 * in line to be woken up, wait for our turn.
+	 */
+	if (wait && waitqueue_active(&rwb->wait) &&
+	    rwb->wait.task_list.next != &wait->task_list)
+		return false;
+
+	return atomic_inc_below(&rwb->inflight, get_limit(rwb, rw));
+}
+
+/*
+ * Block if we will exceed our limit, or if we are currently waiting for
+ * the timer to kick off queuing again.
+ */
+static void __wbt_wait(struct rq_wb *rwb, unsigned long rw, spinlock_t *lock)
+	__releases(lock)
+	__acquires(lock)
+{
+	DEFINE_WAIT(wait);
+
+	if (may_queue(rwb, NULL, rw))
+		return;
+
+	do {
+		prepare_to_wait_exclusive(&rwb->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+
+		if (may_queue(rwb, &wait, rw))
+			break;
+
+		if (lock) {
+			spin_unlock_irq(lock);
+			io_schedule();
+			spin_lock_irq(lock);
+		} else
+			io_schedule();
+	} while (1);
+
+	finish_wait(&rwb->wait, &wait);
+}
+
+static inline bool wbt_should_throttle(struct bio *bio)
+{
+	const unsigned long rw = bio->bi_rw;
+
+	/*
+	 * Only throttle buffered writes: O_DIRECT sets REQ_SYNC without
+	 * REQ_NOIDLE, discards and empty flushes have nothing to throttle.
+	 */
+	if (!(rw & REQ_WRITE) || (rw & REQ_DISCARD) || !bio_sectors(bio))
+		return false;
+	if ((rw & (REQ_SYNC | REQ_NOIDLE)) == REQ_SYNC)
+		return false;
+
+	return true;
+}
+
+static void rwb_arm_timer(struct rq_wb *rwb)
+{
+	unsigned long expires;
+
+	if (rwb->scale_step > 0) {
+		/*
+		 * We should speed this up, using some variant of a fast
+		 * integer inverse square root calculation. Since we only do
+		 * this for every window expiration, it's not a huge deal,
+		 * though.
+		 */
+		rwb->cur_win_nsec = div_u64(rwb->win_nsec << 4,
+					int_sqrt((rwb->scale_step + 1) << 8));
+	} else {
+		/*
+		 * For step < 0, we don't want to increase/decrease the
+		 * window size.
+		 */
+		rwb->cur_win_nsec = rwb->win_nsec;
+	}
+
+	expires = jiffies + max(1UL, nsecs_to_jiffies(rwb->cur_win_nsec));
+	mod_timer(&rwb->window_timer, expires);
+}
+
+/*
+ * Returns 0 if the bio doesn't need to be tracked, otherwise the
+ * wbt_flags to attach to the request with wbt_track(). May sleep; if
+ * @lock is given, it is dropped while sleeping.
+ */
+unsigned int wbt_wait(struct rq_wb *rwb, struct bio *bio, spinlock_t *lock)
+{
+	unsigned int ret = 0;
+
+	if (!rwb_enabled(rwb))
+		return 0;
+
+	if (!wbt_should_throttle(bio)) {
+		wb_timestamp(rwb, &rwb->last_issue);
+		return 0;
+	}
+
+	if (current_is_kswapd())
+		ret |= WBT_KSWAPD;
+
+	__wbt_wait(rwb, bio->bi_rw, lock);
+
+	if (!timer_pending(&rwb->window_timer))
+		rwb_arm_timer(rwb);
+
+	return ret | WBT_TRACKED;
+}
+
+void wbt_issue(struct rq_wb *rwb, struct request *rq)
+{
+	if (!rwb_enabled(rwb))
+		return;
+
+	/*
+	 * Track the issue time of reads, and of tracked writes so that
+	 * completions of unstarted (merged) requests are not counted.
+	 */
+	if (rq->wbt_flags & WBT_TRACKED)
+		rq->wbt_issue_ns = ktime_get_ns();
+	else if (rq->cmd_type == REQ_TYPE_FS && rq_data_dir(rq) == READ &&
+		 blk_rq_bytes(rq)) {
+		rq->wbt_issue_ns = ktime_get_ns();
+		rq->wbt_flags |= WBT_READ;
+	}
+}
+
+void wbt_requeue(struct rq_wb *rwb, struct request *rq)
+{
+	if (!rwb)
+		return;
+
+	rq->wbt_flags &= ~WBT_READ;
+	rq->wbt_issue_ns = 0;
+}
+
+static void calc_wb_limits(struct rq_wb *rwb)
+{
+	unsigned int depth;
+
+	if (!rwb->min_lat_nsec) {
+		rwb->wb_max = rwb->wb_normal = rwb->wb_background = 0;
+		return;
+	}
+
+	/*
+	 * For QD=1 devices, this is a special case. It's important for those
+	 * to have one request ready when one completes, so force a depth of
+	 * 2 for those devices. On the backend, it'll be a depth of 1 anyway,
+	 * since the device can't have more than that in flight.
+	 */
+	if (rwb->queue_depth == 1) {
+		if (rwb->scale_step > 0)
+			rwb->wb_max = 1;
+		else {
+			rwb->wb_max = 2;
+			rwb->scaled_max = true;
+		}
+	} else {
+		depth = min_t(unsigned int, RWB_DEF_DEPTH, rwb->queue_depth);
+
+		/*
+		 * scale_step == 0 is our default state. If we have suffered
+		 * latency spikes, step will be > 0, and we shrink the
+		 * allowed write depths. If step is < 0, we're only doing
+		 * writes, and we allow a temporarily higher depth to
+		 * increase performance.
+		 */
+		if (rwb->scale_step > 0)
+			depth = 1 + ((depth - 1) >> min(31, rwb->scale_step));
+		else if (rwb->scale_step < 0) {
+			unsigned int maxd = 3 * rwb->queue_depth / 4;
+
+			depth = 1 + ((depth - 1) << -rwb->scale_step);
+			if (depth > maxd) {
+				depth = maxd;
+				rwb->scaled_max = true;
+			}
+		}
+		rwb->wb_max = depth;
+	}
+
+	rwb->wb_normal = (rwb->wb_max + 1) / 2;
+	rwb->wb_background = (rwb->wb_max + 3) / 4;
+}
+
+static void scale_up(struct rq_wb *rwb)
+{
+	/*
+	 * Hit max in previous round, stop here
+	 */
+	if (rwb->scaled_max)
+		return;
+
+	rwb->scale_step--;
+	rwb->unknown_cnt = 0;
+
+	calc_wb_limits(rwb);
+	rwb_wake_all(rwb);
+}
+
+/*
+ * Scale rwb down. If 'hard_throttle' is set, do it quicker, since we
+ * had a latency violation.
+ */
+static void scale_down(struct rq_wb *rwb, bool hard_throttle)
+{
+	/*
+	 * Stop scaling down when we've hit the limit. This also prevents
+	 * ->scale_step from going to crazy values, if the device can't
+	 * keep up.
+	 */
+	if (rwb->wb_max == 1)
+		return;
+
+	if (rwb->scale_step < 0 && hard_throttle)
+		rwb->scale_step = 0;
+	else
+		rwb->scale_step++;
+
+	rwb->scaled_max = false;
+	rwb->unknown_cnt = 0;
+	calc_wb_limits(rwb);
+}
+
+static int latency_exceeded(struct rq_wb *rwb)
+{
+	unsigned int reads, writes;
+	unsigned long flags;
+	u64 read_min;
+
+	spin_lock_irqsave(&rwb->stat_lock, flags);
+	reads = rwb->read_samples;
+	writes = rwb->write_samples;
+	read_min = rwb->read_min_nsec;
+	rwb->read_samples = rwb->write_samples = 0;
+	rwb->read_min_nsec = 0;
+	spin_unlock_irqrestore(&rwb->stat_lock, flags);
+
+	/*
+	 * If we had writes in this stat window and the window is current,
+	 * we're only doing writes. If a task recently waited or still has
+	 * writes in flights, consider us doing just writes as well.
+	 */
+	if (reads < RWB_MIN_READ_SAMPLES) {
+		if (writes || atomic_read(&rwb->inflight))
+			return LAT_UNKNOWN_WRITES;
+		return LAT_UNKNOWN;
+	}
+
+	/*
+	 * If the 'min' latency exceeds our target, step down.
+	 */
+	if (read_min > rwb->min_lat_nsec)
+		return LAT_EXCEEDED;
+
+	return LAT_OK;
+}
+
+static void wb_timer_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *) data;
+	unsigned int inflight = atomic_read(&rwb->inflight);
+
+	if (!rwb_enabled(rwb))
+		return;
+
+	switch (latency_exceeded(rwb)) {
+	case LAT_EXCEEDED:
+		scale_down(rwb, true);
+		break;
+	case LAT_OK:
+		scale_up(rwb);
+		break;
+	case LAT_UNKNOWN_WRITES:
+		/*
+		 * We started a the center step, but don't have a valid
+		 * read/write sample, but we do have writes going on.
+		 * Allow step to go negative, to increase write perf.
+		 */
+		scale_up(rwb);
+		break;
+	case LAT_UNKNOWN:
+		if (++rwb->unknown_cnt < RWB_UNKNOWN_BUMP)
+			break;
+		/*
+		 * We get here when previously scaled reduced depth, and we
+		 * currently don't have a valid read/write sample. For that
+		 * case, slowly return to center state (step == 0).
+		 */
+		if (rwb->scale_step > 0)
+			scale_up(rwb);
+		else if (rwb->scale_step < 0)
+			scale_down(rwb, false);
+		break;
+	default:
+		break;
+	}
+
+	/*
+	 * Re-arm timer, if we have IO in flight
+	 */
+	if (rwb->scale_step || inflight)
+		rwb_arm_timer(rwb);
+}
+
+void wbt_update_limits(struct rq_wb *rwb)
+{
+	rwb->scale_step = 0;
+	rwb->scaled_max = false;
+	calc_wb_limits(rwb);
+
+	rwb_wake_all(rwb);
+}
+
+void wbt_set_queue_depth(struct rq_wb *rwb, unsigned int depth)
+{
+	if (rwb) {
+		rwb->queue_depth = depth;
+		wbt_update_limits(rwb);
+	}
+}
+
+u64 wbt_default_latency_nsec(struct request_queue *q)
+{
+	/*
+	 * We default to 2msec for non-rotational storage, and 75msec
+	 * for rotational storage.
+	 */
+	if (blk_queue_nonrot(q))
+		return RWB_DEF_LAT_NONROT;
+	else
+		return RWB_DEF_LAT_ROT;
+}
+
+int wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	/*
+	 * Only request based queues have a request to track
+	 */
+	if (!q->request_fn && !q->mq_ops)
+		return -EINVAL;
+
+	rwb = kzalloc(sizeof(*rwb), GFP_KERNEL);
+	if (!rwb)
+		return -ENOMEM;
+
+	atomic_set(&rwb->inflight, 0);
+	init_waitqueue_head(&rwb->wait);
+	spin_lock_init(&rwb->stat_lock);
+	setup_timer(&rwb->window_timer, wb_timer_fn, (unsigned long) rwb);
+	rwb->last_comp = rwb->last_issue = jiffies;
+	rwb->queue = q;
+	rwb->win_nsec = RWB_WINDOW_NSEC;
+	rwb->min_lat_nsec = wbt_default_latency_nsec(q);
+	rwb->queue_depth = q->nr_requests;
+	wbt_update_limits(rwb);
+
+	q->rq_wb = rwb;
+	return 0;
+}
+
+void wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (rwb) {
+		del_timer_sync(&rwb->window_timer);
+		q->rq_wb = NULL;
+		kfree(rwb);
+	}
+}
+
+/*
+ * Called when a request based queue is registered, to enable throttling
+ * with the default latency target for this type of device, if throttling
+ * is on by default for this type of queue.
+ */
+void wbt_enable_default(struct request_queue *q)
+{
+	/* Throttling already enabled? */
+	if (q->rq_wb)
+		return;
+
+	if ((q->request_fn && IS_ENABLED(CONFIG_BLK_WBT_SQ)) ||
+	    (q->mq_ops && IS_ENABLED(CONFIG_BLK_WBT_MQ)))
+		wbt_init(q);
+}
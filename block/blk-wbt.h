@@ -0,0 +1,130 @@
+#ifndef BLK_WBT_H
+#define BLK_WBT_H
+
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/wait.h>
+#include <linux/timer.h>
+#include <linux/spinlock.h>
+#include <linux/blkdev.h>
+
+enum wbt_flags {
+	WBT_TRACKED		= 1,	/* write, tracked for throttling */
+	WBT_KSWAPD		= 2,	/* write, from kswapd */
+	WBT_READ		= 4,	/* read, sampled for latency */
+};
+
+/*
+ * Per-queue writeback throttling state. Buffered writes are allowed a
+ * limited number of requests in flight; that limit is scaled up or down
+ * each monitoring window depending on whether read completion latency
+ * stayed below ->min_lat_nsec.
+ */
+struct rq_wb {
+	/*
+	 * Settings that govern how we throttle
+	 */
+	unsigned int wb_background;		/* background writeback */
+	unsigned int wb_normal;			/* normal writeback */
+	unsigned int wb_max;			/* max throughput writeback */
+	int scale_step;
+	bool scaled_max;
+
+	unsigned int queue_depth;
+	unsigned int unknown_cnt;
+
+	u64 win_nsec;				/* default window size */
+	u64 cur_win_nsec;			/* current window size */
+	u64 min_lat_nsec;			/* read latency target */
+
+	unsigned long last_issue;		/* last non-throttled issue */
+	unsigned long last_comp;		/* last non-throttled comp */
+
+	struct timer_list window_timer;
+
+	/*
+	 * Read completion latency and write completions seen in the
+	 * current window
+	 */
+	spinlock_t stat_lock;
+	u64 read_min_nsec;
+	unsigned int read_samples;
+	unsigned int write_samples;
+
+	atomic_t inflight;
+	wait_queue_head_t wait;
+
+	struct request_queue *queue;
+};
+
+#ifdef CONFIG_BLK_WBT
+
+int wbt_init(struct request_queue *);
+void wbt_exit(struct request_queue *);
+void wbt_enable_default(struct request_queue *);
+u64 wbt_default_latency_nsec(struct request_queue *);
+void wbt_update_limits(struct rq_wb *);
+void wbt_set_queue_depth(struct rq_wb *, unsigned int);
+
+unsigned int wbt_wait(struct rq_wb *, struct bio *, spinlock_t *);
+void __wbt_done(struct rq_wb *, unsigned int);
+void wbt_issue(struct rq_wb *, struct request *);
+void wbt_requeue(struct rq_wb *, struct request *);
+void wbt_done(struct rq_wb *, struct request *);
+
+static inline void wbt_track(struct request *rq, unsigned int flags)
+{
+	rq->wbt_flags |= flags;
+}
+
+static inline void wbt_clear_state(struct request *rq)
+{
+	rq->wbt_flags = 0;
+	rq->wbt_issue_ns = 0;
+}
+
+#else
+
+static inline int wbt_init(struct request_queue *q)
+{
+	return -EINVAL;
+}
+static inline void wbt_exit(struct request_queue *q)
+{
+}
+static inline void wbt_enable_default(struct request_queue *q)
+{
+}
+static inline void wbt_update_limits(struct rq_wb *rwb)
+{
+}
+static inline void wbt_set_queue_depth(struct rq_wb *rwb, unsigned int depth)
+{
+}
+static inline unsigned int wbt_wait(struct rq_wb *rwb, struct bio *bio,
+				    spinlock_t *lock)
+{
+	return 0;
+}
+static inline void __wbt_done(struct rq_wb *rwb, unsigned int flags)
+{
+}
+static inline void wbt_issue(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_requeue(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_done(struct rq_wb *rwb, struct request *rq)
+{
+}
+static inline void wbt_track(struct request *rq, unsigned int flags)
+{
+}
+static inline void wbt_clear_state(struct request *rq)
+{
+}
+
+#endif /* CONFIG_BLK_WBT */
+
+#endif
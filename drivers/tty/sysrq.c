@@ -534,6 +534,8 @@ void __handle_sysrq(int key, bool check_mask)
 
 	rcu_sysrq_start();
 	rcu_read_lock();
+	/* sysrq is used on stuck systems, don't rely on the printk kthread */
+	printk_emergency_begin();
 	/*
 	 * Raise the apparent loglevel to maximum so that the sysrq header
 	 * is shown to provide the user with positive feedback.  We do not
@@ -575,6 +577,7 @@ void __handle_sysrq(int key, bool check_mask)
 		pr_cont("\n");
 		console_loglevel = orig_log_level;
 	}
+	printk_emergency_end();
 	rcu_read_unlock();
 	rcu_sysrq_end();
 }
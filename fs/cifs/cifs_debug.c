@@ -296,6 +296,14 @@ static ssize_t cifs_stats_proc_write(struct file *file,
 		list_for_each(tmp1, &cifs_tcp_ses_list) {
 			server = list_entry(tmp1, struct TCP_Server_Info,
 					    tcp_ses_list);
+#ifdef CONFIG_CIFS_STATS2
+			memset(server->num_cmds, 0, sizeof(server->num_cmds));
+			memset(server->time_per_cmd, 0,
+			       sizeof(server->time_per_cmd));
+			memset(server->slowest_cmd, 0,
+			       sizeof(server->slowest_cmd));
+			server->num_compounds = 0;
+#endif /* CONFIG_CIFS_STATS2 */
 			list_for_each(tmp2, &server->smb_ses_list) {
 				ses = list_entry(tmp2, struct cifs_ses,
 						 smb_ses_list);
@@ -321,6 +329,35 @@ static ssize_t cifs_stats_proc_write(struct file *file,
 	return count;
 }
 
+#ifdef CONFIG_CIFS_STATS2
+/*
+ * Response latency of SMB2+ commands on this connection, in microseconds,
+ * measured from the request being sent to its response being demultiplexed.
+ */
+static void cifs_server_latency_show(struct seq_file *m,
+				     struct TCP_Server_Info *server)
+{
+	int j;
+
+	if (!server->vals->protocol_id)
+		return;
+
+	seq_printf(m, "\nServer %s: %u compounded requests",
+		   server->hostname, server->num_compounds);
+	seq_puts(m, "\nCommand latency (usecs): count total average slowest");
+	for (j = 0; j < NUMBER_OF_SMB2_COMMANDS; j++) {
+		if (!server->num_cmds[j])
+			continue;
+		seq_printf(m, "\n%d: %u %llu %llu %u", j,
+			   server->num_cmds[j], server->time_per_cmd[j],
+			   div_u64(server->time_per_cmd[j],
+				   server->num_cmds[j]),
+			   server->slowest_cmd[j]);
+	}
+	seq_putc(m, '\n');
+}
+#endif /* CONFIG_CIFS_STATS2 */
+
 static int cifs_stats_proc_show(struct seq_file *m, void *v)
 {
 	int i;
@@ -359,6 +396,9 @@ static int cifs_stats_proc_show(struct seq_file *m, void *v)
 	list_for_each(tmp1, &cifs_tcp_ses_list) {
 		server = list_entry(tmp1, struct TCP_Server_Info,
 				    tcp_ses_list);
+#ifdef CONFIG_CIFS_STATS2
+		cifs_server_latency_show(m, server);
+#endif /* CONFIG_CIFS_STATS2 */
 		list_for_each(tmp2, &server->smb_ses_list) {
 			ses = list_entry(tmp2, struct cifs_ses,
 					 smb_ses_list);
@@ -156,6 +156,9 @@ struct cifs_cred {
  * formed by a kvec array, followed by an array of pages. Page data is assumed
  * to start at the beginning of the first page.
  */
+/* most requests that can be chained into one compound */
+#define MAX_COMPOUND	5
+
 struct smb_rqst {
 	struct kvec	*rq_iov;	/* array of kvecs */
 	unsigned int	rq_nvec;	/* number of kvecs in array */
@@ -226,6 +229,8 @@ struct smb_version_operations {
 	void (*dump_share_caps)(struct seq_file *, struct cifs_tcon *);
 	/* verify the message */
 	int (*check_message)(char *, unsigned int);
+	/* offset of the next PDU in a compounded response, 0 if none */
+	unsigned int (*next_header)(char *);
 	bool (*is_oplock_break)(char *, struct TCP_Server_Info *);
 	int (*handle_cancelled_mid)(char *, struct TCP_Server_Info *);
 	void (*downgrade_oplock)(struct TCP_Server_Info *,
@@ -626,6 +631,14 @@ struct TCP_Server_Info {
 #ifdef CONFIG_CIFS_STATS2
 	atomic_t in_send; /* requests trying to send */
 	atomic_t num_waiters;   /* blocked waiting to get in sendrecv */
+	/*
+	 * SMB2+ response latency per command, in microseconds. Only
+	 * updated from the demultiplex thread.
+	 */
+	unsigned int num_cmds[NUMBER_OF_SMB2_COMMANDS];
+	__u64 time_per_cmd[NUMBER_OF_SMB2_COMMANDS];
+	__u32 slowest_cmd[NUMBER_OF_SMB2_COMMANDS];
+	unsigned int num_compounds; /* compound chains sent, srv_mutex */
 #endif
 #ifdef CONFIG_CIFS_SMB2
 	unsigned int	max_read;
@@ -1291,6 +1304,7 @@ struct mid_q_entry {
 #ifdef CONFIG_CIFS_STATS2
 	unsigned long when_sent; /* time when smb send finished */
 	unsigned long when_received; /* when demux complete (taken off wire) */
+	ktime_t issue_time;	/* precise send time, for latency stats */
 #endif
 	mid_receive_t *receive; /* call receive callback */
 	mid_callback_t *callback; /* call completion callback */
@@ -1337,6 +1351,7 @@ static inline void cifs_num_waiters_dec(struct TCP_Server_Info *server)
 static inline void cifs_save_when_sent(struct mid_q_entry *mid)
 {
 	mid->when_sent = jiffies;
+	mid->issue_time = ktime_get();
 }
 #else
 static inline void cifs_in_send_inc(struct TCP_Server_Info *server)
@@ -739,11 +739,38 @@ is_smb_response(struct TCP_Server_Info *server, unsigned char type)
 	return false;
 }
 
+#ifdef CONFIG_CIFS_STATS2
+/*
+ * Account the response latency of an SMB2+ request, shown per command in
+ * /proc/fs/cifs/Stats. Called from the demultiplex thread only.
+ */
+static void
+cifs_account_latency(struct mid_q_entry *mid)
+{
+	struct TCP_Server_Info *server = mid->server;
+	unsigned int cmd = le16_to_cpu(mid->command);
+	s64 usecs;
+
+	if (!server->vals->protocol_id || cmd >= NUMBER_OF_SMB2_COMMANDS ||
+	    !ktime_to_ns(mid->issue_time))
+		return;
+
+	usecs = ktime_us_delta(ktime_get(), mid->issue_time);
+	if (usecs < 0)
+		usecs = 0;
+	server->num_cmds[cmd]++;
+	server->time_per_cmd[cmd] += usecs;
+	if (usecs > server->slowest_cmd[cmd])
+		server->slowest_cmd[cmd] = min_t(s64, usecs, U32_MAX);
+}
+#endif
+
 void
 dequeue_mid(struct mid_q_entry *mid, bool malformed)
 {
 #ifdef CONFIG_CIFS_STATS2
 	mid->when_received = jiffies;
+	cifs_account_latency(mid);
 #endif
 	spin_lock(&GlobalMid_Lock);
 	if (!malformed)
@@ -929,7 +956,7 @@ cifs_demultiplex_thread(void *p)
 {
 	int length;
 	struct TCP_Server_Info *server = p;
-	unsigned int pdu_length;
+	unsigned int pdu_length, next_length;
 	char *buf = NULL;
 	struct task_struct *task_to_wake = NULL;
 	struct mid_q_entry *mid_entry;
@@ -968,6 +995,8 @@ cifs_demultiplex_thread(void *p)
 		cifs_dbg(FYI, "RFC1002 header 0x%x\n", pdu_length);
 		if (!is_smb_response(server, buf[0]))
 			continue;
+next_pdu:
+		next_length = 0;
 
 		/* make sure we have enough to get to the MID */
 		if (pdu_length < HEADER_SIZE(server) - 1 - 4) {
@@ -985,6 +1014,30 @@ cifs_demultiplex_thread(void *p)
 			continue;
 		server->total_read += length;
 
+		/*
+		 * A compounded response carries several PDUs in one frame.
+		 * Each of them is handled as if it had arrived on its own,
+		 * with the RFC1002 length in the buffer trimmed to cover just
+		 * that PDU (including its padding).
+		 */
+		if (server->ops->next_header) {
+			unsigned int next_offset = server->ops->next_header(buf);
+
+			if (next_offset) {
+				if (next_offset < HEADER_SIZE(server) - 1 - 4 ||
+				    next_offset >= pdu_length) {
+					cifs_dbg(VFS, "Bad compound offset %u in %u byte frame\n",
+						 next_offset, pdu_length);
+					cifs_reconnect(server);
+					wake_up(&server->response_q);
+					continue;
+				}
+				next_length = pdu_length - next_offset;
+				pdu_length = next_offset;
+				*(__be32 *)buf = cpu_to_be32(pdu_length);
+			}
+		}
+
 		mid_entry = server->ops->find_mid(server, buf);
 
 		if (!mid_entry || !mid_entry->receive)
@@ -992,8 +1045,15 @@ cifs_demultiplex_thread(void *p)
 		else
 			length = mid_entry->receive(server, mid_entry);
 
-		if (length < 0)
+		if (length < 0) {
+			/*
+			 * The rest of the frame can still be parsed unless
+			 * the error made us drop the connection.
+			 */
+			if (next_length && server->tcpStatus == CifsGood)
+				goto next_in_frame;
 			continue;
+		}
 
 		if (server->large_buf)
 			buf = server->bigbuf;
@@ -1024,6 +1084,21 @@ cifs_demultiplex_thread(void *p)
 #endif /* CIFS_DEBUG2 */
 
 		}
+next_in_frame:
+		if (next_length) {
+			if (!allocate_buffers(server)) {
+				/* the stream is mid-frame, resync by reconnecting */
+				cifs_reconnect(server);
+				wake_up(&server->response_q);
+				continue;
+			}
+			server->large_buf = false;
+			buf = server->smallbuf;
+			pdu_length = next_length;
+			*(__be32 *)buf = cpu_to_be32(pdu_length);
+			server->total_read = 4;
+			goto next_pdu;
+		}
 	} /* end while !EXITING */
 
 	/* buffer usually freed in free_mid - need to free it here on exit */
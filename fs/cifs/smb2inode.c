@@ -37,6 +37,93 @@
 #include "smb2pdu.h"
 #include "smb2proto.h"
 
+/*
+ * Open, query and close, or just open and close, a path in one round trip by
+ * compounding the requests. The query and close refer to the handle opened
+ * earlier in the chain as COMPOUND_FID.
+ */
+static int
+smb2_compound_op(const unsigned int xid, struct cifs_tcon *tcon,
+		 __le16 *utf16_path, __u32 desired_access,
+		 __u32 create_disposition, __u32 create_options, void *data,
+		 int command)
+{
+	struct cifs_open_parms oparms;
+	struct cifs_fid fid;
+	struct smb_rqst rqst[3];
+	struct kvec open_iov[3], qi_iov[2], close_iov[1];
+	struct kvec rsp_iov[3];
+	int resp_buftype[3];
+	struct smb2_query_info_rsp *qi_rsp;
+	__le16 *copy_path;
+	int num_rqst = 0, i, rc;
+
+	memset(rqst, 0, sizeof(rqst));
+
+	oparms.tcon = tcon;
+	oparms.desired_access = desired_access;
+	oparms.disposition = create_disposition;
+	oparms.create_options = create_options;
+	oparms.fid = &fid;
+	oparms.reconnect = false;
+
+	rc = SMB2_open_init(tcon, open_iov, &oparms, utf16_path, &copy_path);
+	if (rc)
+		return rc;
+	rqst[num_rqst].rq_iov = open_iov;
+	rqst[num_rqst++].rq_nvec = 2;
+
+	if (command == SMB2_OP_QUERY_INFO) {
+		rc = SMB2_query_info_init(tcon, qi_iov, COMPOUND_FID,
+					  COMPOUND_FID, FILE_ALL_INFORMATION,
+					  sizeof(struct smb2_file_all_info) +
+					  PATH_MAX * 2);
+		if (rc)
+			goto free_rqst;
+		rqst[num_rqst].rq_iov = qi_iov;
+		rqst[num_rqst++].rq_nvec = 1;
+	}
+
+	rc = SMB2_close_init(tcon, close_iov, COMPOUND_FID, COMPOUND_FID);
+	if (rc)
+		goto free_rqst;
+	rqst[num_rqst].rq_iov = close_iov;
+	rqst[num_rqst++].rq_nvec = 1;
+
+	for (i = 0; i < num_rqst; i++) {
+		if (i < num_rqst - 1)
+			smb2_set_next_command(&rqst[i]);
+		if (i > 0)
+			smb2_set_related(&rqst[i]);
+	}
+
+	rc = compound_send_recv(xid, tcon->ses, 0, num_rqst, rqst,
+				resp_buftype, rsp_iov);
+	if (rc) {
+		if (rc != -EDEADLK)
+			cifs_stats_fail_inc(tcon, SMB2_CREATE_HE);
+		goto free_rsp;
+	}
+
+	if (command == SMB2_OP_QUERY_INFO) {
+		qi_rsp = rsp_iov[1].iov_base;
+		rc = smb2_validate_and_copy_buf(
+				le16_to_cpu(qi_rsp->OutputBufferOffset),
+				le32_to_cpu(qi_rsp->OutputBufferLength),
+				&qi_rsp->hdr, sizeof(struct smb2_file_all_info),
+				data);
+	}
+
+free_rsp:
+	for (i = 0; i < num_rqst; i++)
+		free_rsp_buf(resp_buftype[i], rsp_iov[i].iov_base);
+free_rqst:
+	for (i = 0; i < num_rqst; i++)
+		cifs_small_buf_release(rqst[i].rq_iov[0].iov_base);
+	kfree(copy_path);
+	return rc;
+}
+
 static int
 smb2_open_op_close(const unsigned int xid, struct cifs_tcon *tcon,
 		   struct cifs_sb_info *cifs_sb, const char *full_path,
@@ -53,6 +140,20 @@ smb2_open_op_close(const unsigned int xid, struct cifs_tcon *tcon,
 	if (!utf16_path)
 		return -ENOMEM;
 
+	switch (command) {
+	case SMB2_OP_DELETE:
+	case SMB2_OP_QUERY_INFO:
+	case SMB2_OP_MKDIR:
+		rc = smb2_compound_op(xid, tcon, utf16_path, desired_access,
+				      create_disposition, create_options, data,
+				      command);
+		/* Too few credits for the chain, send the requests one by one */
+		if (rc != -EDEADLK) {
+			kfree(utf16_path);
+			return rc;
+		}
+	}
+
 	oparms.tcon = tcon;
 	oparms.desired_access = desired_access;
 	oparms.disposition = create_disposition;
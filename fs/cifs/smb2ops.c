@@ -195,6 +195,14 @@ smb2_find_mid(struct TCP_Server_Info *server, char *buf)
 	return NULL;
 }
 
+static unsigned int
+smb2_next_header(char *buf)
+{
+	struct smb2_hdr *hdr = (struct smb2_hdr *)buf;
+
+	return le32_to_cpu(hdr->NextCommand);
+}
+
 static void
 smb2_dump_detail(void *buf)
 {
@@ -1538,6 +1546,7 @@ struct smb_version_operations smb20_operations = {
 	.map_error = map_smb2_to_linux_error,
 	.find_mid = smb2_find_mid,
 	.check_message = smb2_check_message,
+	.next_header = smb2_next_header,
 	.dump_detail = smb2_dump_detail,
 	.clear_stats = smb2_clear_stats,
 	.print_stats = smb2_print_stats,
@@ -1618,6 +1627,7 @@ struct smb_version_operations smb21_operations = {
 	.map_error = map_smb2_to_linux_error,
 	.find_mid = smb2_find_mid,
 	.check_message = smb2_check_message,
+	.next_header = smb2_next_header,
 	.dump_detail = smb2_dump_detail,
 	.clear_stats = smb2_clear_stats,
 	.print_stats = smb2_print_stats,
@@ -1700,6 +1710,7 @@ struct smb_version_operations smb30_operations = {
 	.map_error = map_smb2_to_linux_error,
 	.find_mid = smb2_find_mid,
 	.check_message = smb2_check_message,
+	.next_header = smb2_next_header,
 	.dump_detail = smb2_dump_detail,
 	.clear_stats = smb2_clear_stats,
 	.print_stats = smb2_print_stats,
@@ -1789,6 +1800,7 @@ struct smb_version_operations smb311_operations = {
 	.map_error = map_smb2_to_linux_error,
 	.find_mid = smb2_find_mid,
 	.check_message = smb2_check_message,
+	.next_header = smb2_next_header,
 	.dump_detail = smb2_dump_detail,
 	.clear_stats = smb2_clear_stats,
 	.print_stats = smb2_print_stats,
@@ -343,6 +343,46 @@ small_smb2_init(__le16 smb2_command, struct cifs_tcon *tcon,
 	return rc;
 }
 
+static char smb2_padding[7] = {0};
+
+/*
+ * Chain @rqst to the request following it in a compound: pad it out to an
+ * 8 byte boundary and point NextCommand past it. rq_iov must have room for
+ * one more kvec. Must be called before the request is signed.
+ */
+void
+smb2_set_next_command(struct smb_rqst *rqst)
+{
+	struct smb2_hdr *hdr = rqst->rq_iov[0].iov_base;
+	unsigned int i, len = 0, pad;
+
+	for (i = 0; i < rqst->rq_nvec; i++)
+		len += rqst->rq_iov[i].iov_len;
+	/* the RFC1001 length field is not part of the PDU */
+	len -= 4;
+
+	pad = (8 - (len & 7)) & 7;
+	if (pad) {
+		rqst->rq_iov[rqst->rq_nvec].iov_base = smb2_padding;
+		rqst->rq_iov[rqst->rq_nvec].iov_len = pad;
+		rqst->rq_nvec++;
+		inc_rfc1001_len(hdr, pad);
+	}
+	hdr->NextCommand = cpu_to_le32(len + pad);
+}
+
+/*
+ * Mark @rqst as operating on the file opened earlier in the same compound,
+ * which the request refers to with COMPOUND_FID.
+ */
+void
+smb2_set_related(struct smb_rqst *rqst)
+{
+	struct smb2_hdr *hdr = rqst->rq_iov[0].iov_base;
+
+	hdr->Flags |= SMB2_FLAGS_RELATED_OPERATIONS;
+}
+
 #ifdef CONFIG_CIFS_SMB311
 /* offset is sizeof smb2_negotiate_req - 4 but rounded up to 8 bytes */
 #define OFFSET_OF_NEG_CONTEXT 0x68  /* sizeof(struct smb2_negotiate_req) - 4 */
@@ -1347,32 +1387,23 @@ add_durable_context(struct kvec *iov, unsigned int *num_iovec,
 	return 0;
 }
 
+/*
+ * Build the fixed part of a CREATE request and its path name in iov[0] and
+ * iov[1]. The request buffer is released with cifs_small_buf_release() and
+ * *copy_path, if set, with kfree() once the request has been sent.
+ */
 int
-SMB2_open(const unsigned int xid, struct cifs_open_parms *oparms, __le16 *path,
-	  __u8 *oplock, struct smb2_file_all_info *buf,
-	  struct smb2_err_rsp **err_buf)
+SMB2_open_init(struct cifs_tcon *tcon, struct kvec *iov,
+	       struct cifs_open_parms *oparms, __le16 *path,
+	       __le16 **copy_path)
 {
 	struct smb2_create_req *req;
-	struct smb2_create_rsp *rsp;
-	struct TCP_Server_Info *server;
-	struct cifs_tcon *tcon = oparms->tcon;
-	struct cifs_ses *ses = tcon->ses;
-	struct kvec iov[4];
-	int resp_buftype;
 	int uni_path_len;
-	__le16 *copy_path = NULL;
 	int copy_size;
-	int rc = 0;
-	unsigned int num_iovecs = 2;
+	int rc;
 	__u32 file_attributes = 0;
-	char *dhc_buf = NULL, *lc_buf = NULL;
-
-	cifs_dbg(FYI, "create/open\n");
 
-	if (ses && (ses->server))
-		server = ses->server;
-	else
-		return -EIO;
+	*copy_path = NULL;
 
 	rc = small_smb2_init(SMB2_CREATE, tcon, (void **) &req);
 	if (rc)
@@ -1407,13 +1438,15 @@ SMB2_open(const unsigned int xid, struct cifs_open_parms *oparms, __le16 *path,
 		if (copy_size < uni_path_len)
 			copy_size += 8;
 
-		copy_path = kzalloc(copy_size, GFP_KERNEL);
-		if (!copy_path)
+		*copy_path = kzalloc(copy_size, GFP_KERNEL);
+		if (!*copy_path) {
+			cifs_small_buf_release(req);
 			return -ENOMEM;
-		memcpy((char *)copy_path, (const char *)path,
+		}
+		memcpy((char *)*copy_path, (const char *)path,
 			uni_path_len);
 		uni_path_len = copy_size;
-		path = copy_path;
+		path = *copy_path;
 	}
 
 	iov[1].iov_len = uni_path_len;
@@ -1421,6 +1454,38 @@ SMB2_open(const unsigned int xid, struct cifs_open_parms *oparms, __le16 *path,
 	/* -1 since last byte is buf[0] which was counted in smb2_buf_len */
 	inc_rfc1001_len(req, uni_path_len - 1);
 
+	return 0;
+}
+
+int
+SMB2_open(const unsigned int xid, struct cifs_open_parms *oparms, __le16 *path,
+	  __u8 *oplock, struct smb2_file_all_info *buf,
+	  struct smb2_err_rsp **err_buf)
+{
+	struct smb2_create_req *req;
+	struct smb2_create_rsp *rsp;
+	struct TCP_Server_Info *server;
+	struct cifs_tcon *tcon = oparms->tcon;
+	struct cifs_ses *ses = tcon->ses;
+	struct kvec iov[4];
+	int resp_buftype;
+	__le16 *copy_path = NULL;
+	int rc = 0;
+	unsigned int num_iovecs = 2;
+	char *dhc_buf = NULL, *lc_buf = NULL;
+
+	cifs_dbg(FYI, "create/open\n");
+
+	if (ses && (ses->server))
+		server = ses->server;
+	else
+		return -EIO;
+
+	rc = SMB2_open_init(tcon, iov, oparms, path, &copy_path);
+	if (rc)
+		return rc;
+	req = iov[0].iov_base;
+
 	if (!server->oplocks)
 		*oplock = SMB2_OPLOCK_LEVEL_NONE;
 
@@ -1665,11 +1730,31 @@ SMB2_set_compression(const unsigned int xid, struct cifs_tcon *tcon,
 	return rc;
 }
 
+int
+SMB2_close_init(struct cifs_tcon *tcon, struct kvec *iov,
+		u64 persistent_fid, u64 volatile_fid)
+{
+	struct smb2_close_req *req;
+	int rc;
+
+	rc = small_smb2_init(SMB2_CLOSE, tcon, (void **) &req);
+	if (rc)
+		return rc;
+
+	req->PersistentFileId = persistent_fid;
+	req->VolatileFileId = volatile_fid;
+
+	iov[0].iov_base = (char *)req;
+	/* 4 for rfc1002 length field */
+	iov[0].iov_len = get_rfc1002_length(req) + 4;
+
+	return 0;
+}
+
 int
 SMB2_close(const unsigned int xid, struct cifs_tcon *tcon,
 	   u64 persistent_fid, u64 volatile_fid)
 {
-	struct smb2_close_req *req;
 	struct smb2_close_rsp *rsp;
 	struct TCP_Server_Info *server;
 	struct cifs_ses *ses = tcon->ses;
@@ -1684,17 +1769,10 @@ SMB2_close(const unsigned int xid, struct cifs_tcon *tcon,
 	else
 		return -EIO;
 
-	rc = small_smb2_init(SMB2_CLOSE, tcon, (void **) &req);
+	rc = SMB2_close_init(tcon, iov, persistent_fid, volatile_fid);
 	if (rc)
 		return rc;
 
-	req->PersistentFileId = persistent_fid;
-	req->VolatileFileId = volatile_fid;
-
-	iov[0].iov_base = (char *)req;
-	/* 4 for rfc1002 length field */
-	iov[0].iov_len = get_rfc1002_length(req) + 4;
-
 	rc = SendReceive2(xid, ses, iov, 1, &resp_buftype, 0);
 	rsp = (struct smb2_close_rsp *)iov[0].iov_base;
 
@@ -1746,10 +1824,10 @@ validate_buf(unsigned int offset, unsigned int buffer_length,
  * If SMB buffer fields are valid, copy into temporary buffer to hold result.
  * Caller must free buffer.
  */
-static int
-validate_and_copy_buf(unsigned int offset, unsigned int buffer_length,
-		      struct smb2_hdr *hdr, unsigned int minbufsize,
-		      char *data)
+int
+smb2_validate_and_copy_buf(unsigned int offset, unsigned int buffer_length,
+			   struct smb2_hdr *hdr, unsigned int minbufsize,
+			   char *data)
 
 {
 	char *begin_of_buf = 4 /* RFC1001 len field */ + offset + (char *)hdr;
@@ -1767,12 +1845,39 @@ validate_and_copy_buf(unsigned int offset, unsigned int buffer_length,
 	return 0;
 }
 
+int
+SMB2_query_info_init(struct cifs_tcon *tcon, struct kvec *iov,
+		     u64 persistent_fid, u64 volatile_fid, u8 info_class,
+		     size_t output_len)
+{
+	struct smb2_query_info_req *req;
+	int rc;
+
+	rc = small_smb2_init(SMB2_QUERY_INFO, tcon, (void **) &req);
+	if (rc)
+		return rc;
+
+	req->InfoType = SMB2_O_INFO_FILE;
+	req->FileInfoClass = info_class;
+	req->PersistentFileId = persistent_fid;
+	req->VolatileFileId = volatile_fid;
+	/* 4 for rfc1002 length field and 1 for Buffer */
+	req->InputBufferOffset =
+		cpu_to_le16(sizeof(struct smb2_query_info_req) - 1 - 4);
+	req->OutputBufferLength = cpu_to_le32(output_len);
+
+	iov[0].iov_base = (char *)req;
+	/* 4 for rfc1002 length field */
+	iov[0].iov_len = get_rfc1002_length(req) + 4;
+
+	return 0;
+}
+
 static int
 query_info(const unsigned int xid, struct cifs_tcon *tcon,
 	   u64 persistent_fid, u64 volatile_fid, u8 info_class,
 	   size_t output_len, size_t min_len, void *data)
 {
-	struct smb2_query_info_req *req;
 	struct smb2_query_info_rsp *rsp = NULL;
 	struct kvec iov[2];
 	int rc = 0;
@@ -1787,23 +1892,11 @@ query_info(const unsigned int xid, struct cifs_tcon *tcon,
 	else
 		return -EIO;
 
-	rc = small_smb2_init(SMB2_QUERY_INFO, tcon, (void **) &req);
+	rc = SMB2_query_info_init(tcon, iov, persistent_fid, volatile_fid,
+				  info_class, output_len);
 	if (rc)
 		return rc;
 
-	req->InfoType = SMB2_O_INFO_FILE;
-	req->FileInfoClass = info_class;
-	req->PersistentFileId = persistent_fid;
-	req->VolatileFileId = volatile_fid;
-	/* 4 for rfc1002 length field and 1 for Buffer */
-	req->InputBufferOffset =
-		cpu_to_le16(sizeof(struct smb2_query_info_req) - 1 - 4);
-	req->OutputBufferLength = cpu_to_le32(output_len);
-
-	iov[0].iov_base = (char *)req;
-	/* 4 for rfc1002 length field */
-	iov[0].iov_len = get_rfc1002_length(req) + 4;
-
 	rc = SendReceive2(xid, ses, iov, 1, &resp_buftype, 0);
 	rsp = (struct smb2_query_info_rsp *)iov[0].iov_base;
 
@@ -1812,9 +1905,9 @@ query_info(const unsigned int xid, struct cifs_tcon *tcon,
 		goto qinf_exit;
 	}
 
-	rc = validate_and_copy_buf(le16_to_cpu(rsp->OutputBufferOffset),
-				   le32_to_cpu(rsp->OutputBufferLength),
-				   &rsp->hdr, min_len, data);
+	rc = smb2_validate_and_copy_buf(le16_to_cpu(rsp->OutputBufferOffset),
+					le32_to_cpu(rsp->OutputBufferLength),
+					&rsp->hdr, min_len, data);
 
 qinf_exit:
 	free_rsp_buf(resp_buftype, rsp);
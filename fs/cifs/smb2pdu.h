@@ -145,6 +145,9 @@ struct smb2_transform_hdr {
 #define SMB2_FLAGS_SIGNED		cpu_to_le32(0x00000008)
 #define SMB2_FLAGS_DFS_OPERATIONS	cpu_to_le32(0x10000000)
 
+/* file id used by related operations for the handle opened in the chain */
+#define COMPOUND_FID	0xFFFFFFFFFFFFFFFFULL
+
 /*
  *	Definitions for SMB2 Protocol Data Units (network frames)
  *
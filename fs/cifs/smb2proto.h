@@ -113,6 +113,11 @@ extern int SMB2_tcon(const unsigned int xid, struct cifs_ses *ses,
 		     const char *tree, struct cifs_tcon *tcon,
 		     const struct nls_table *);
 extern int SMB2_tdis(const unsigned int xid, struct cifs_tcon *tcon);
+extern void smb2_set_next_command(struct smb_rqst *rqst);
+extern void smb2_set_related(struct smb_rqst *rqst);
+extern int SMB2_open_init(struct cifs_tcon *tcon, struct kvec *iov,
+			  struct cifs_open_parms *oparms, __le16 *path,
+			  __le16 **copy_path);
 extern int SMB2_open(const unsigned int xid, struct cifs_open_parms *oparms,
 		     __le16 *path, __u8 *oplock,
 		     struct smb2_file_all_info *buf,
@@ -123,11 +128,20 @@ extern int SMB2_ioctl(const unsigned int xid, struct cifs_tcon *tcon,
 		     char **out_data, u32 *plen /* returned data len */);
 extern int SMB2_close(const unsigned int xid, struct cifs_tcon *tcon,
 		      u64 persistent_file_id, u64 volatile_file_id);
+extern int SMB2_close_init(struct cifs_tcon *tcon, struct kvec *iov,
+			   u64 persistent_fid, u64 volatile_fid);
 extern int SMB2_flush(const unsigned int xid, struct cifs_tcon *tcon,
 		      u64 persistent_file_id, u64 volatile_file_id);
 extern int SMB2_query_info(const unsigned int xid, struct cifs_tcon *tcon,
 			   u64 persistent_file_id, u64 volatile_file_id,
 			   struct smb2_file_all_info *data);
+extern int SMB2_query_info_init(struct cifs_tcon *tcon, struct kvec *iov,
+				u64 persistent_fid, u64 volatile_fid,
+				u8 info_class, size_t output_len);
+extern int smb2_validate_and_copy_buf(unsigned int offset,
+				      unsigned int buffer_length,
+				      struct smb2_hdr *hdr,
+				      unsigned int minbufsize, char *data);
 extern int SMB2_get_srv_num(const unsigned int xid, struct cifs_tcon *tcon,
 			    u64 persistent_fid, u64 volatile_fid,
 			    __le64 *uniqueid);
@@ -448,6 +448,58 @@ wait_for_free_request(struct TCP_Server_Info *server, const int timeout,
 	return wait_for_free_credits(server, timeout, val);
 }
 
+static bool
+has_compound_credits(struct TCP_Server_Info *server, int *credits, int num)
+{
+	bool ret;
+
+	spin_lock(&server->req_lock);
+	ret = *credits >= num || server->in_flight == 0;
+	spin_unlock(&server->req_lock);
+	return ret;
+}
+
+/*
+ * Take the credits for a whole compound chain at once. Taking them one by
+ * one would let concurrent chains each hold part of a small credit pool
+ * and wait for each other forever. Returns -EDEADLK if there are not
+ * enough credits and no request in flight to return more, in which case
+ * the caller should send the requests one at a time.
+ */
+static int
+wait_for_compound_request(struct TCP_Server_Info *server, const int num,
+			  const int optype)
+{
+	int *credits = server->ops->get_credits_field(server, optype);
+	int rc;
+
+	spin_lock(&server->req_lock);
+	while (*credits < num) {
+		if (server->in_flight == 0) {
+			spin_unlock(&server->req_lock);
+			return -EDEADLK;
+		}
+		spin_unlock(&server->req_lock);
+		cifs_num_waiters_inc(server);
+		rc = wait_event_killable(server->request_q,
+				has_compound_credits(server, credits, num));
+		cifs_num_waiters_dec(server);
+		if (rc)
+			return rc;
+		spin_lock(&server->req_lock);
+	}
+
+	if (server->tcpStatus == CifsExiting) {
+		spin_unlock(&server->req_lock);
+		return -ENOENT;
+	}
+
+	*credits -= num;
+	server->in_flight += num;
+	spin_unlock(&server->req_lock);
+	return 0;
+}
+
 int
 cifs_wait_mtu_credits(struct TCP_Server_Info *server, unsigned int size,
 		      unsigned int *num, unsigned int *credits)
@@ -706,6 +758,201 @@ cifs_setup_request(struct cifs_ses *ses, struct smb_rqst *rqst)
 	return mid;
 }
 
+/*
+ * Send a chain of related requests to the server in a single frame and wait
+ * for all of their responses. Each request in @rqst must already carry its
+ * NextCommand offset and padding, see smb2_set_next_command(). The request
+ * buffers are left to the caller; responses are returned in @resp_iov and
+ * @resp_buf_type just as SendReceive2() returns them, and the caller must
+ * free every one of them. Returns the first error seen in the chain, or
+ * -EDEADLK if the credits for the whole chain cannot be obtained.
+ */
+int
+compound_send_recv(const unsigned int xid, struct cifs_ses *ses,
+		   const int flags, const int num_rqst, struct smb_rqst *rqst,
+		   int *resp_buf_type, struct kvec *resp_iov)
+{
+	int i, j, rc = 0, tmprc;
+	int timeout, optype;
+	struct TCP_Server_Info *server;
+	struct mid_q_entry *midQ[MAX_COMPOUND];
+	struct kvec *iov;
+	struct smb_rqst crqst;
+	unsigned int credits, nvec = 1, len = 0;
+	__be32 rfc1002_marker;
+
+	timeout = flags & CIFS_TIMEOUT_MASK;
+	optype = flags & CIFS_OP_MASK;
+
+	for (i = 0; i < num_rqst; i++) {
+		resp_buf_type[i] = CIFS_NO_BUFFER;  /* no response buf yet */
+		resp_iov[i].iov_base = NULL;
+		resp_iov[i].iov_len = 0;
+	}
+
+	if ((ses == NULL) || (ses->server == NULL)) {
+		cifs_dbg(VFS, "Null session\n");
+		return -EIO;
+	}
+	server = ses->server;
+
+	if (num_rqst > MAX_COMPOUND || timeout == CIFS_ASYNC_OP)
+		return -EINVAL;
+
+	if (server->tcpStatus == CifsExiting)
+		return -ENOENT;
+
+	/* one frame: a single RFC1002 header followed by every request */
+	for (i = 0; i < num_rqst; i++) {
+		if (WARN_ON_ONCE(rqst[i].rq_npages))
+			return -EINVAL;
+		for (j = 0; j < rqst[i].rq_nvec; j++)
+			len += rqst[i].rq_iov[j].iov_len;
+		len -= 4;
+		nvec += rqst[i].rq_nvec;
+	}
+
+	iov = kmalloc_array(nvec, sizeof(struct kvec), GFP_NOFS);
+	if (!iov)
+		return -ENOMEM;
+
+	rfc1002_marker = cpu_to_be32(len);
+	iov[0].iov_base = &rfc1002_marker;
+	iov[0].iov_len = 4;
+	nvec = 1;
+	for (i = 0; i < num_rqst; i++) {
+		iov[nvec].iov_base = rqst[i].rq_iov[0].iov_base + 4;
+		iov[nvec].iov_len = rqst[i].rq_iov[0].iov_len - 4;
+		nvec++;
+		for (j = 1; j < rqst[i].rq_nvec; j++)
+			iov[nvec++] = rqst[i].rq_iov[j];
+	}
+	crqst.rq_iov = iov;
+	crqst.rq_nvec = nvec;
+	crqst.rq_pages = NULL;
+	crqst.rq_npages = 0;
+
+	/* every request in the chain consumes a credit */
+	rc = wait_for_compound_request(server, num_rqst, optype);
+	if (rc)
+		goto out_free;
+
+	/*
+	 * Make sure that we sign in the same order that we send on this socket
+	 * and avoid races inside tcp sendmsg code that could cause corruption
+	 * of smb data.
+	 */
+
+	mutex_lock(&server->srv_mutex);
+
+	for (i = 0; i < num_rqst; i++) {
+		midQ[i] = server->ops->setup_request(ses, &rqst[i]);
+		if (IS_ERR(midQ[i])) {
+			rc = PTR_ERR(midQ[i]);
+			for (j = 0; j < i; j++)
+				cifs_delete_mid(midQ[j]);
+			mutex_unlock(&server->srv_mutex);
+			/*
+			 * Update # of requests on wire to server: add_credits()
+			 * only drops in_flight by one, so return them one by one.
+			 */
+			for (j = 0; j < num_rqst; j++)
+				add_credits(server, 1, optype);
+			goto out_free;
+		}
+		midQ[i]->mid_state = MID_REQUEST_SUBMITTED;
+	}
+
+	cifs_in_send_inc(server);
+	rc = smb_send_rqst(server, &crqst);
+	cifs_in_send_dec(server);
+	for (i = 0; i < num_rqst; i++)
+		cifs_save_when_sent(midQ[i]);
+
+	if (rc < 0)
+		server->sequence_number -= 2 * num_rqst;
+#ifdef CONFIG_CIFS_STATS2
+	else
+		server->num_compounds++;
+#endif
+	mutex_unlock(&server->srv_mutex);
+
+	if (rc < 0) {
+		for (i = 0; i < num_rqst; i++) {
+			cifs_delete_mid(midQ[i]);
+			add_credits(server, 1, optype);
+		}
+		goto out_free;
+	}
+
+	for (i = 0; i < num_rqst; i++) {
+		tmprc = wait_for_response(server, midQ[i]);
+		if (tmprc == 0)
+			continue;
+
+		/* hand the mids still on the wire over to the demultiplexer */
+		if (!rc)
+			rc = tmprc;
+		cifs_dbg(FYI, "Cancelling wait for mid %llu\n", midQ[i]->mid);
+		spin_lock(&GlobalMid_Lock);
+		if (midQ[i]->mid_state == MID_REQUEST_SUBMITTED) {
+			midQ[i]->mid_flags |= MID_WAIT_CANCELLED;
+			midQ[i]->callback = DeleteMidQEntry;
+			spin_unlock(&GlobalMid_Lock);
+			add_credits(server, 1, optype);
+			midQ[i] = NULL;
+			continue;
+		}
+		spin_unlock(&GlobalMid_Lock);
+	}
+
+	for (i = 0; i < num_rqst; i++) {
+		if (!midQ[i])
+			continue;
+
+		tmprc = cifs_sync_mid_result(midQ[i], server);
+		if (tmprc != 0) {
+			add_credits(server, 1, optype);
+			if (!rc)
+				rc = tmprc;
+			continue;
+		}
+
+		if (!midQ[i]->resp_buf ||
+		    midQ[i]->mid_state != MID_RESPONSE_RECEIVED) {
+			cifs_dbg(FYI, "Bad MID state?\n");
+			if (!rc)
+				rc = -EIO;
+			cifs_delete_mid(midQ[i]);
+			add_credits(server, 1, optype);
+			continue;
+		}
+
+		resp_iov[i].iov_base = midQ[i]->resp_buf;
+		resp_iov[i].iov_len = get_rfc1002_length(midQ[i]->resp_buf) + 4;
+		if (midQ[i]->large_buf)
+			resp_buf_type[i] = CIFS_LARGE_BUFFER;
+		else
+			resp_buf_type[i] = CIFS_SMALL_BUFFER;
+
+		credits = server->ops->get_credits(midQ[i]);
+
+		tmprc = server->ops->check_receive(midQ[i], server,
+						   flags & CIFS_LOG_ERROR);
+		if (tmprc && !rc)
+			rc = tmprc;
+
+		/* mark it so buf will not be freed by cifs_delete_mid */
+		midQ[i]->resp_buf = NULL;
+		cifs_delete_mid(midQ[i]);
+		add_credits(server, credits, optype);
+	}
+
+out_free:
+	kfree(iov);
+	return rc;
+}
+
 int
 SendReceive2(const unsigned int xid, struct cifs_ses *ses,
 	     struct kvec *iov, int n_vec, int *resp_buf_type /* ret */,
@@ -320,15 +320,25 @@ static void dio_bio_end_aio(struct bio *bio)
  *
  * During I/O bi_private points at the dio.  After I/O, bi_private is used to
  * implement a singly-linked list of completed BIOs, at dio->bio_list.
+ *
+ * Only reads into user memory need the process context, to redirty the
+ * pages.  Everything else is completed right here so that the waiter only
+ * has to wait for the last reference to go away.
  */
 static void dio_bio_end_io(struct bio *bio)
 {
 	struct dio *dio = bio->bi_private;
 	unsigned long flags;
+	bool inline_complete = (dio->rw & WRITE) || !dio->should_dirty;
+
+	if (inline_complete)
+		dio_bio_complete(dio, bio);
 
 	spin_lock_irqsave(&dio->bio_lock, flags);
-	bio->bi_private = dio->bio_list;
-	dio->bio_list = bio;
+	if (!inline_complete) {
+		bio->bi_private = dio->bio_list;
+		dio->bio_list = bio;
+	}
 	if (--dio->refcount == 1 && dio->waiter)
 		wake_up_process(dio->waiter);
 	spin_unlock_irqrestore(&dio->bio_lock, flags);
@@ -1058,6 +1068,197 @@ out:
 	return ret;
 }
 
+/*
+ * Handle a hole found by the extent based path below.  Reads are zero
+ * filled one block at a time, as we cannot trust ->b_size for unmapped
+ * buffers.  Returns 1 when we hit EOF.
+ */
+static inline int dio_extent_hole(struct dio *dio, struct dio_submit *sdio)
+{
+	const unsigned blkbits = sdio->blkbits;
+	loff_t i_size_aligned;
+
+	/* AKPM: eargh, -ENOTBLK is a hack */
+	if (dio->rw & WRITE)
+		return -ENOTBLK;
+
+	i_size_aligned = ALIGN(i_size_read(dio->inode), 1 << blkbits);
+	if (sdio->block_in_file >= i_size_aligned >> blkbits)
+		return 1;
+
+	/* The bio under assembly is no longer logically contiguous */
+	if (sdio->bio)
+		dio_bio_submit(dio, sdio);
+
+	if (iov_iter_zero(1 << blkbits, sdio->iter) != 1 << blkbits)
+		return -EFAULT;
+
+	sdio->block_in_file++;
+	dio->result += 1 << blkbits;
+	return 0;
+}
+
+/*
+ * Add @len bytes of @page at @offset to the bio under assembly, which must
+ * continue at @sector.  The page reference is handed over to the bio.
+ * @nr_pages is the number of pages still to be added, including this one,
+ * and sizes a new bio.
+ */
+static inline int dio_extent_add_page(struct dio *dio,
+		struct dio_submit *sdio, struct buffer_head *map_bh,
+		struct page *page, unsigned offset, unsigned len,
+		sector_t sector, int nr_pages)
+{
+	int ret;
+
+	if (sdio->bio && bio_end_sector(sdio->bio) != sector)
+		dio_bio_submit(dio, sdio);
+
+	if (!sdio->bio ||
+	    bio_add_page(sdio->bio, page, len, offset) != len) {
+		if (sdio->bio)
+			dio_bio_submit(dio, sdio);
+		ret = dio_bio_reap(dio, sdio);
+		if (ret)
+			return ret;
+		dio_bio_alloc(dio, sdio, map_bh->b_bdev, sector,
+			      clamp(nr_pages, 1, BIO_MAX_PAGES));
+		sdio->logical_offset_in_bio =
+			(loff_t)sdio->block_in_file << sdio->blkbits;
+		ret = bio_add_page(sdio->bio, page, len, offset);
+		BUG_ON(ret != len);
+	}
+
+	if (dio->rw & WRITE)
+		task_io_account_write(len);
+	return 0;
+}
+
+/*
+ * Put the mapped extent in @map_bh under IO, straight from the pinned user
+ * pages into as few bios as the queue limits allow.
+ */
+static int dio_extent_submit(struct dio *dio, struct dio_submit *sdio,
+			     struct buffer_head *map_bh)
+{
+	const unsigned blkbits = sdio->blkbits;
+	sector_t sector = map_bh->b_blocknr << (blkbits - 9);
+	size_t left;
+	int ret = 0;
+
+	left = min_t(sector_t, map_bh->b_size >> blkbits,
+		     sdio->final_block_in_request - sdio->block_in_file)
+		<< blkbits;
+
+	while (left) {
+		ssize_t bytes;
+		size_t from;
+		int i, nr, more;
+
+		bytes = iov_iter_get_pages(sdio->iter, dio->pages, left,
+					   DIO_PAGES, &from);
+		if (bytes <= 0) {
+			ret = bytes ? bytes : -EFAULT;
+			break;
+		}
+		nr = DIV_ROUND_UP(bytes + from, PAGE_SIZE);
+		/* Size bios from this batch and what the extent has after it */
+		iov_iter_advance(sdio->iter, bytes);
+		more = 0;
+		if (left > bytes)
+			more = min_t(size_t,
+				     iov_iter_npages(sdio->iter, BIO_MAX_PAGES),
+				     DIV_ROUND_UP(left - bytes, PAGE_SIZE) + 1);
+
+		for (i = 0; i < nr; i++) {
+			unsigned len = min_t(size_t, bytes, PAGE_SIZE - from);
+
+			ret = dio_extent_add_page(dio, sdio, map_bh,
+						  dio->pages[i], from, len,
+						  sector, nr - i + more);
+			if (ret) {
+				while (i < nr)
+					page_cache_release(dio->pages[i++]);
+				return ret;
+			}
+			sector += len >> 9;
+			sdio->block_in_file += len >> blkbits;
+			dio->result += len;
+			bytes -= len;
+			left -= len;
+			from = 0;
+		}
+	}
+
+	if (ret && (dio->rw & WRITE)) {
+		/*
+		 * A memory fault, but the filesystem has given us mapped
+		 * blocks.  Write zeroes to them to avoid leaking stale data
+		 * in the file.
+		 */
+		int err;
+
+		if (dio->page_errors == 0)
+			dio->page_errors = ret;
+		while (left) {
+			unsigned len = min_t(size_t, left, PAGE_SIZE);
+			struct page *page = ZERO_PAGE(0);
+
+			page_cache_get(page);
+			err = dio_extent_add_page(dio, sdio, map_bh, page, 0,
+						  len, sector,
+						  DIV_ROUND_UP(left, PAGE_SIZE));
+			if (err) {
+				page_cache_release(page);
+				break;
+			}
+			sector += len >> 9;
+			sdio->block_in_file += len >> blkbits;
+			left -= len;
+		}
+	}
+
+	if (!ret && buffer_boundary(map_bh) && sdio->bio)
+		dio_bio_submit(dio, sdio);
+	return ret;
+}
+
+/*
+ * Extent based variant of do_direct_IO() for requests aligned to the
+ * filesystem block size.  Each get_block() call maps as much of the
+ * remaining range as the filesystem can, and the whole mapping is put
+ * under IO at once, skipping the per-page deferral of submit_page_section().
+ */
+static int do_direct_IO_extents(struct dio *dio, struct dio_submit *sdio,
+				struct buffer_head *map_bh)
+{
+	int ret = 0;
+
+	while (sdio->block_in_file < sdio->final_block_in_request) {
+		ret = get_more_blocks(dio, sdio, map_bh);
+		if (ret)
+			break;
+
+		if (!buffer_mapped(map_bh)) {
+			ret = dio_extent_hole(dio, sdio);
+			if (ret) {
+				if (ret == 1)
+					ret = 0;
+				break;
+			}
+			continue;
+		}
+
+		if (buffer_new(map_bh))
+			clean_blockdev_aliases(dio, map_bh);
+
+		ret = dio_extent_submit(dio, sdio, map_bh);
+		if (ret)
+			break;
+	}
+	return ret;
+}
+
 static inline int drop_refcount(struct dio *dio)
 {
 	int ret2;
@@ -1253,9 +1454,17 @@ do_blockdev_direct_IO(struct kiocb *iocb, struct inode *inode,
 
 	blk_start_plug(&plug);
 
-	retval = do_direct_IO(dio, &sdio, &map_bh);
-	if (retval)
-		dio_cleanup(dio, &sdio);
+	/*
+	 * Requests aligned to the fs block size without a custom submission
+	 * hook can be mapped and submitted an extent at a time.
+	 */
+	if (!sdio.blkfactor && !submit_io) {
+		retval = do_direct_IO_extents(dio, &sdio, &map_bh);
+	} else {
+		retval = do_direct_IO(dio, &sdio, &map_bh);
+		if (retval)
+			dio_cleanup(dio, &sdio);
+	}
 
 	if (retval == -ENOTBLK) {
 		/*
@@ -739,7 +739,8 @@ static void nfs_server_set_fsinfo(struct nfs_server *server,
 	server->rpages = (server->rsize + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
 
 	server->backing_dev_info.name = "nfs";
-	server->backing_dev_info.ra_pages = server->rpages * NFS_MAX_READAHEAD;
+	server->ra_rpcs = max(nfs_max_readahead_rpcs, NFS_MIN_READAHEAD);
+	server->backing_dev_info.ra_pages = server->rpages * server->ra_rpcs;
 
 	if (server->wsize > max_rpc_payload)
 		server->wsize = max_rpc_payload;
@@ -884,6 +885,7 @@ struct nfs_server *nfs_alloc_server(void)
 	INIT_LIST_HEAD(&server->delegations);
 	INIT_LIST_HEAD(&server->layouts);
 	INIT_LIST_HEAD(&server->state_owners_lru);
+	spin_lock_init(&server->ra_lock);
 
 	atomic_set(&server->active, 0);
 
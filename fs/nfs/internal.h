@@ -12,13 +12,14 @@
 
 struct nfs_string;
 
-/* Maximum number of readahead requests
- * FIXME: this should really be a sysctl so that users may tune it to suit
- *        their needs. People that do NFS over a slow network, might for
- *        instance want to reduce it to something closer to 1 for improved
- *        interactive response.
+/* Default maximum number of readahead requests, tunable through the
+ * nfs.max_readahead_rpcs module parameter. The readahead window actually
+ * used is adapted between NFS_MIN_READAHEAD and that maximum according to
+ * the READ round trip times seen on the mount, see nfs_read_update_ra().
  */
 #define NFS_MAX_READAHEAD	(RPC_DEF_SLOT_TABLE - 1)
+#define NFS_MIN_READAHEAD	(2U)
+#define NFS_MAX_READAHEAD_LIMIT	(256U)
 
 static inline void nfs_attr_check_mountpoint(struct super_block *parent, struct nfs_fattr *fattr)
 {
@@ -431,6 +432,7 @@ extern int nfs4_get_rootfh(struct nfs_server *server, struct nfs_fh *mntfh, bool
 
 struct nfs_pgio_completion_ops;
 /* read.c */
+extern unsigned int nfs_max_readahead_rpcs;
 extern void nfs_pageio_init_read(struct nfs_pageio_descriptor *pgio,
 			struct inode *inode, bool force_mds,
 			const struct nfs_pgio_completion_ops *compl_ops);
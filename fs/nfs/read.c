@@ -212,6 +212,90 @@ static const struct nfs_pgio_completion_ops nfs_async_read_completion_ops = {
 	.completion = nfs_read_completion,
 };
 
+unsigned int nfs_max_readahead_rpcs = NFS_MAX_READAHEAD;
+
+static int param_set_ra_rpcs(const char *val, const struct kernel_param *kp)
+{
+	unsigned int num;
+	int ret;
+
+	if (!val)
+		return -EINVAL;
+	ret = kstrtouint(val, 0, &num);
+	if (ret)
+		return ret;
+	*((unsigned int *)kp->arg) = clamp(num, NFS_MIN_READAHEAD,
+					   NFS_MAX_READAHEAD_LIMIT);
+	return 0;
+}
+static const struct kernel_param_ops param_ops_ra_rpcs = {
+	.set = param_set_ra_rpcs,
+	.get = param_get_uint,
+};
+#define param_check_ra_rpcs(name, p) __param_check(name, p, unsigned int);
+
+module_param_named(max_readahead_rpcs, nfs_max_readahead_rpcs, ra_rpcs, 0644);
+MODULE_PARM_DESC(max_readahead_rpcs,
+		 "Maximum number of readahead READ RPCs per file (2-256)");
+
+#define NFS_RA_ADJUST_SAMPLES	16		/* READs between adjustments */
+#define NFS_RA_RTT_WINDOW	(10 * HZ)	/* lifetime of read_rtt_min */
+
+/*
+ * Adapt the readahead window of a mount to the server's READ latency.
+ *
+ * While the smoothed RTT stays close to the lowest recently observed RTT
+ * the server is keeping up, and the window grows by one rsize READ per
+ * adjustment up to nfs_max_readahead_rpcs. Once the smoothed RTT exceeds
+ * twice that minimum, requests are queueing at the server or on the wire
+ * and more readahead only adds latency, so the window is halved.
+ *
+ * Files pick up the new window the next time they are opened.
+ */
+static void nfs_read_update_ra(struct nfs_server *server,
+			       struct rpc_task *task)
+{
+	struct rpc_rqst *req = task->tk_rqstp;
+	unsigned int max_rpcs = max(nfs_max_readahead_rpcs, NFS_MIN_READAHEAD);
+	unsigned int ra_rpcs;
+	u32 rtt;
+
+	if (!req || task->tk_status < 0)
+		return;
+	rtt = min_t(s64, ktime_to_us(req->rq_rtt), U32_MAX);
+	if (!rtt)
+		return;
+
+	spin_lock(&server->ra_lock);
+	if (!server->read_rtt_min || rtt < server->read_rtt_min ||
+	    time_after(jiffies, server->read_rtt_stamp + NFS_RA_RTT_WINDOW)) {
+		server->read_rtt_min = rtt;
+		server->read_rtt_stamp = jiffies;
+	}
+	if (server->read_rtt_avg)
+		server->read_rtt_avg += ((s32)(rtt - server->read_rtt_avg)) / 8;
+	else
+		server->read_rtt_avg = rtt;
+
+	if (++server->ra_samples < NFS_RA_ADJUST_SAMPLES)
+		goto out;
+	server->ra_samples = 0;
+
+	ra_rpcs = server->ra_rpcs;
+	if (server->read_rtt_avg > 2 * server->read_rtt_min)
+		ra_rpcs = max(ra_rpcs / 2, NFS_MIN_READAHEAD);
+	else if (server->read_rtt_avg <
+		 server->read_rtt_min + server->read_rtt_min / 4)
+		ra_rpcs++;
+	ra_rpcs = min(ra_rpcs, max_rpcs);
+	if (ra_rpcs != server->ra_rpcs) {
+		server->ra_rpcs = ra_rpcs;
+		server->backing_dev_info.ra_pages = server->rpages * ra_rpcs;
+	}
+out:
+	spin_unlock(&server->ra_lock);
+}
+
 /*
  * This is the callback from RPC telling us whether a reply was
  * received or some error occurred (timeout or socket shutdown).
@@ -225,6 +309,7 @@ static int nfs_readpage_done(struct rpc_task *task,
 		return status;
 
 	nfs_add_stats(inode, NFSIOS_SERVERREADBYTES, hdr->res.count);
+	nfs_read_update_ra(NFS_SERVER(inode), task);
 
 	if (task->tk_status == -ESTALE) {
 		set_bit(NFS_INO_STALE, &NFS_I(inode)->flags);
@@ -18,7 +18,9 @@
  * is much larger than a sockaddr_in6.
  */
 struct svc_cacherep {
+	struct hlist_node	c_hash;		/* RCU protected lookup chain */
 	struct list_head	c_lru;
+	struct rcu_head		c_rcu;
 
 	unsigned char		c_state,	/* unused, inprog, done */
 				c_type,		/* status, buffer */
@@ -74,13 +76,16 @@ enum {
 /* Cache entries expire after this time period */
 #define RC_EXPIRE		(120 * HZ)
 
-/* Checksum this amount of the request */
+/* Checksum this amount of the request by default, and at most this much */
 #define RC_CSUMLEN		(256U)
+#define RC_CSUMLEN_MAX		(4096U)
 
 int	nfsd_reply_cache_init(void);
 void	nfsd_reply_cache_shutdown(void);
 int	nfsd_cache_lookup(struct svc_rqst *);
 void	nfsd_cache_update(struct svc_rqst *, int, __be32 *);
 int	nfsd_reply_cache_stats_open(struct inode *, struct file *);
+unsigned int	nfsd_reply_cache_csum_len(void);
+int	nfsd_reply_cache_set_csum_len(unsigned int);
 
 #endif /* NFSCACHE_H */
@@ -9,6 +9,9 @@
  */
 
 #include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/rculist.h>
+#include <linux/ktime.h>
 #include <linux/sunrpc/addr.h>
 #include <linux/highmem.h>
 #include <linux/log2.h>
@@ -27,14 +30,45 @@
  */
 #define TARGET_BUCKET_SIZE	64
 
+/*
+ * Lookups walk the hash chain under RCU and only take the cache_lock once
+ * they know whether they hit. The generation count is bumped for every
+ * insertion, so that a miss only has to search the chain again under the
+ * lock if something was added to it in the meantime.
+ */
 struct nfsd_drc_bucket {
+	struct hlist_head cache_hash;
 	struct list_head lru_head;
 	spinlock_t cache_lock;
+	unsigned int gen;
 };
 
 static struct nfsd_drc_bucket	*drc_hashtbl;
 static struct kmem_cache	*drc_slab;
 
+/*
+ * Number of entries kept on each CPU's free list. Entries are recycled
+ * through these after an RCU grace period, so that the common case of a
+ * miss followed by an insert doesn't have to go to the slab allocator.
+ */
+#define DRC_PCPU_POOL_SIZE	32
+
+struct nfsd_drc_pcpu {
+	spinlock_t		lock;
+	unsigned int		nr_free;
+	struct list_head	free;
+
+	/* lookup latency, in nsecs */
+	u64			lookups;
+	u64			lookup_nsec;
+	u64			max_lookup_nsec;
+};
+
+static struct nfsd_drc_pcpu __percpu *drc_pcpu;
+
+/* number of bytes of each request to checksum, 0 to disable */
+static unsigned int		drc_csum_len = RC_CSUMLEN;
+
 /* max number of entries allowed in the cache */
 static unsigned int		max_drc_entries;
 
@@ -121,17 +155,55 @@ nfsd_cache_hash(__be32 xid)
 static struct svc_cacherep *
 nfsd_reply_cache_alloc(void)
 {
-	struct svc_cacherep	*rp;
+	struct nfsd_drc_pcpu	*pc = raw_cpu_ptr(drc_pcpu);
+	struct svc_cacherep	*rp = NULL;
+
+	spin_lock_bh(&pc->lock);
+	if (pc->nr_free) {
+		rp = list_first_entry(&pc->free, struct svc_cacherep, c_lru);
+		list_del(&rp->c_lru);
+		pc->nr_free--;
+	}
+	spin_unlock_bh(&pc->lock);
 
-	rp = kmem_cache_alloc(drc_slab, GFP_KERNEL);
+	if (!rp)
+		rp = kmem_cache_alloc(drc_slab, GFP_KERNEL);
 	if (rp) {
 		rp->c_state = RC_UNUSED;
 		rp->c_type = RC_NOCACHE;
+		INIT_HLIST_NODE(&rp->c_hash);
 		INIT_LIST_HEAD(&rp->c_lru);
 	}
 	return rp;
 }
 
+/*
+ * Give an entry back to this CPU's free list, or to the slab if the list
+ * is full. The entry must not be visible to lookups anymore.
+ */
+static void
+nfsd_reply_cache_recycle(struct svc_cacherep *rp)
+{
+	struct nfsd_drc_pcpu *pc = raw_cpu_ptr(drc_pcpu);
+
+	spin_lock_bh(&pc->lock);
+	if (pc->nr_free < DRC_PCPU_POOL_SIZE) {
+		list_add(&rp->c_lru, &pc->free);
+		pc->nr_free++;
+		rp = NULL;
+	}
+	spin_unlock_bh(&pc->lock);
+
+	if (rp)
+		kmem_cache_free(drc_slab, rp);
+}
+
+static void
+nfsd_reply_cache_free_rcu(struct rcu_head *head)
+{
+	nfsd_reply_cache_recycle(container_of(head, struct svc_cacherep, c_rcu));
+}
+
 static void
 nfsd_reply_cache_free_locked(struct svc_cacherep *rp)
 {
@@ -139,10 +211,11 @@ nfsd_reply_cache_free_locked(struct svc_cacherep *rp)
 		drc_mem_usage -= rp->c_replvec.iov_len;
 		kfree(rp->c_replvec.iov_base);
 	}
+	hlist_del_init_rcu(&rp->c_hash);
 	list_del(&rp->c_lru);
 	atomic_dec(&num_drc_entries);
 	drc_mem_usage -= sizeof(*rp);
-	kmem_cache_free(drc_slab, rp);
+	call_rcu(&rp->c_rcu, nfsd_reply_cache_free_rcu);
 }
 
 static void
@@ -153,6 +226,60 @@ nfsd_reply_cache_free(struct nfsd_drc_bucket *b, struct svc_cacherep *rp)
 	spin_unlock(&b->cache_lock);
 }
 
+static int nfsd_reply_cache_init_pcpu(void)
+{
+	int cpu, i;
+
+	drc_pcpu = alloc_percpu(struct nfsd_drc_pcpu);
+	if (!drc_pcpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct nfsd_drc_pcpu *pc = per_cpu_ptr(drc_pcpu, cpu);
+
+		spin_lock_init(&pc->lock);
+		INIT_LIST_HEAD(&pc->free);
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct nfsd_drc_pcpu *pc = per_cpu_ptr(drc_pcpu, cpu);
+
+		for (i = 0; i < DRC_PCPU_POOL_SIZE; i++) {
+			struct svc_cacherep *rp;
+
+			rp = kmem_cache_alloc(drc_slab, GFP_KERNEL);
+			if (!rp)
+				return -ENOMEM;
+			list_add(&rp->c_lru, &pc->free);
+			pc->nr_free++;
+		}
+	}
+	return 0;
+}
+
+static void nfsd_reply_cache_shutdown_pcpu(void)
+{
+	struct svc_cacherep *rp;
+	int cpu;
+
+	if (!drc_pcpu)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct nfsd_drc_pcpu *pc = per_cpu_ptr(drc_pcpu, cpu);
+
+		while (!list_empty(&pc->free)) {
+			rp = list_first_entry(&pc->free, struct svc_cacherep,
+					      c_lru);
+			list_del(&rp->c_lru);
+			kmem_cache_free(drc_slab, rp);
+		}
+		pc->nr_free = 0;
+	}
+	free_percpu(drc_pcpu);
+	drc_pcpu = NULL;
+}
+
 int nfsd_reply_cache_init(void)
 {
 	unsigned int hashsize;
@@ -173,10 +300,14 @@ int nfsd_reply_cache_init(void)
 	if (!drc_slab)
 		goto out_nomem;
 
+	if (nfsd_reply_cache_init_pcpu())
+		goto out_nomem;
+
 	drc_hashtbl = kcalloc(hashsize, sizeof(*drc_hashtbl), GFP_KERNEL);
 	if (!drc_hashtbl)
 		goto out_nomem;
 	for (i = 0; i < hashsize; i++) {
+		INIT_HLIST_HEAD(&drc_hashtbl[i].cache_hash);
 		INIT_LIST_HEAD(&drc_hashtbl[i].lru_head);
 		spin_lock_init(&drc_hashtbl[i].cache_lock);
 	}
@@ -208,6 +339,10 @@ void nfsd_reply_cache_shutdown(void)
 	drc_hashtbl = NULL;
 	drc_hashsize = 0;
 
+	/* wait for the freed entries to make it back to the pools */
+	rcu_barrier();
+	nfsd_reply_cache_shutdown_pcpu();
+
 	kmem_cache_destroy(drc_slab);
 	drc_slab = NULL;
 }
@@ -279,7 +414,7 @@ nfsd_reply_cache_scan(struct shrinker *shrink, struct shrink_control *sc)
 	return prune_cache_entries();
 }
 /*
- * Walk an xdr_buf and get a CRC for at most the first RC_CSUMLEN bytes
+ * Walk an xdr_buf and get a CRC for at most the first drc_csum_len bytes
  */
 static __wsum
 nfsd_cache_csum(struct svc_rqst *rqstp)
@@ -290,9 +425,16 @@ nfsd_cache_csum(struct svc_rqst *rqstp)
 	struct xdr_buf *buf = &rqstp->rq_arg;
 	const unsigned char *p = buf->head[0].iov_base;
 	size_t csum_len = min_t(size_t, buf->head[0].iov_len + buf->page_len,
-				RC_CSUMLEN);
+				READ_ONCE(drc_csum_len));
 	size_t len = min(buf->head[0].iov_len, csum_len);
 
+	/*
+	 * Payload checksums are disabled, rely on the XID, length and the
+	 * other discriminators only.
+	 */
+	if (!csum_len)
+		return 0;
+
 	/* rq_arg.head first */
 	csum = csum_partial(p, len, 0);
 	csum_len -= len;
@@ -337,25 +479,30 @@ nfsd_cache_match(struct svc_rqst *rqstp, __wsum csum, struct svc_cacherep *rp)
 
 /*
  * Search the request hash for an entry that matches the given rqstp.
- * Must be called with cache_lock held. Returns the found entry or
- * NULL on failure.
+ * Must be called under rcu_read_lock() or with cache_lock held. Returns
+ * the found entry or NULL on failure, and the number of entries walked
+ * in @entries.
  */
 static struct svc_cacherep *
 nfsd_cache_search(struct nfsd_drc_bucket *b, struct svc_rqst *rqstp,
-		__wsum csum)
+		__wsum csum, unsigned int *entries)
 {
-	struct svc_cacherep	*rp, *ret = NULL;
-	struct list_head 	*rh = &b->lru_head;
-	unsigned int		entries = 0;
-
-	list_for_each_entry(rp, rh, c_lru) {
-		++entries;
-		if (nfsd_cache_match(rqstp, csum, rp)) {
-			ret = rp;
-			break;
-		}
+	struct svc_cacherep	*rp;
+
+	hlist_for_each_entry_rcu(rp, &b->cache_hash, c_hash) {
+		++*entries;
+		if (nfsd_cache_match(rqstp, csum, rp))
+			return rp;
 	}
+	return NULL;
+}
 
+/*
+ * Must be called with cache_lock held.
+ */
+static void
+nfsd_cache_chain_stats(unsigned int entries)
+{
 	/* tally hash chain length stats */
 	if (entries > longest_chain) {
 		longest_chain = entries;
@@ -366,16 +513,27 @@ nfsd_cache_search(struct nfsd_drc_bucket *b, struct svc_rqst *rqstp,
 				longest_chain_cachesize,
 				atomic_read(&num_drc_entries));
 	}
+}
 
-	return ret;
+static void
+nfsd_cache_account_lookup(u64 start)
+{
+	struct nfsd_drc_pcpu *pc = get_cpu_ptr(drc_pcpu);
+	u64 delta = ktime_get_ns() - start;
+
+	pc->lookups++;
+	pc->lookup_nsec += delta;
+	if (delta > pc->max_lookup_nsec)
+		pc->max_lookup_nsec = delta;
+	put_cpu_ptr(drc_pcpu);
 }
 
 /*
- * Try to find an entry matching the current call in the cache. When none
- * is found, we try to grab the oldest expired entry off the LRU list. If
- * a suitable one isn't there, then drop the cache_lock and allocate a
- * new one, then search again in case one got inserted while this thread
- * didn't hold the lock.
+ * Try to find an entry matching the current call in the cache. Since the
+ * common case is a miss followed by an insert, an entry is taken from the
+ * per-cpu pool up front. The hash chain is then searched under RCU, and
+ * only searched again under the cache_lock if another entry was inserted
+ * in the meantime.
  */
 int
 nfsd_cache_lookup(struct svc_rqst *rqstp)
@@ -389,8 +547,10 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 	u32 hash = nfsd_cache_hash(xid);
 	struct nfsd_drc_bucket *b = &drc_hashtbl[hash];
 	unsigned long		age;
+	unsigned int		gen, entries = 0;
 	int type = rqstp->rq_cachetype;
 	int rtn = RC_DOIT;
+	u64 start;
 
 	rqstp->rq_cacherep = NULL;
 	if (type == RC_NOCACHE) {
@@ -398,35 +558,45 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 		return rtn;
 	}
 
+	start = ktime_get_ns();
 	csum = nfsd_cache_csum(rqstp);
 
-	/*
-	 * Since the common case is a cache miss followed by an insert,
-	 * preallocate an entry.
-	 */
 	rp = nfsd_reply_cache_alloc();
+
+	rcu_read_lock();
+	gen = READ_ONCE(b->gen);
+	smp_rmb();
+	found = nfsd_cache_search(b, rqstp, csum, &entries);
 	spin_lock(&b->cache_lock);
-	if (likely(rp)) {
-		atomic_inc(&num_drc_entries);
-		drc_mem_usage += sizeof(*rp);
+	rcu_read_unlock();
+
+	/* The entry we found may have been pruned before we got the lock */
+	if (found && hlist_unhashed(&found->c_hash))
+		found = NULL;
+	if (!found && gen != b->gen) {
+		entries = 0;
+		found = nfsd_cache_search(b, rqstp, csum, &entries);
 	}
+	nfsd_cache_chain_stats(entries);
 
-	/* go ahead and prune the cache */
-	prune_bucket(b);
-
-	found = nfsd_cache_search(b, rqstp, csum);
 	if (found) {
 		if (likely(rp))
-			nfsd_reply_cache_free_locked(rp);
+			nfsd_reply_cache_recycle(rp);
 		rp = found;
 		goto found_entry;
 	}
 
+	/* go ahead and prune the cache */
+	prune_bucket(b);
+
 	if (!rp) {
 		dprintk("nfsd: unable to allocate DRC entry!\n");
 		goto out;
 	}
 
+	atomic_inc(&num_drc_entries);
+	drc_mem_usage += sizeof(*rp);
+
 	nfsdstats.rcmisses++;
 	rqstp->rq_cacherep = rp;
 	rp->c_state = RC_INPROG;
@@ -438,18 +608,14 @@ nfsd_cache_lookup(struct svc_rqst *rqstp)
 	rp->c_vers = vers;
 	rp->c_len = rqstp->rq_arg.len;
 	rp->c_csum = csum;
+	rp->c_type = RC_NOCACHE;
 
 	lru_put_end(b, rp);
-
-	/* release any buffer */
-	if (rp->c_type == RC_REPLBUFF) {
-		drc_mem_usage -= rp->c_replvec.iov_len;
-		kfree(rp->c_replvec.iov_base);
-		rp->c_replvec.iov_base = NULL;
-	}
-	rp->c_type = RC_NOCACHE;
+	hlist_add_head_rcu(&rp->c_hash, &b->cache_hash);
+	b->gen++;
  out:
 	spin_unlock(&b->cache_lock);
+	nfsd_cache_account_lookup(start);
 	return rtn;
 
 found_entry:
@@ -582,6 +748,25 @@ nfsd_cache_append(struct svc_rqst *rqstp, struct kvec *data)
 	return 1;
 }
 
+static void nfsd_reply_cache_lookup_stats_show(struct seq_file *m)
+{
+	u64 lookups = 0, nsec = 0, max = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct nfsd_drc_pcpu *pc = per_cpu_ptr(drc_pcpu, cpu);
+
+		lookups += pc->lookups;
+		nsec += pc->lookup_nsec;
+		max = max(max, pc->max_lookup_nsec);
+	}
+
+	seq_printf(m, "lookups:               %llu\n", lookups);
+	seq_printf(m, "avg lookup nsecs:      %llu\n",
+			lookups ? div64_u64(nsec, lookups) : 0);
+	seq_printf(m, "max lookup nsecs:      %llu\n", max);
+}
+
 /*
  * Note that fields may be added, removed or reordered in the future. Programs
  * scraping this file for info should test the labels to ensure they're
@@ -600,6 +785,8 @@ static int nfsd_reply_cache_stats_show(struct seq_file *m, void *v)
 	seq_printf(m, "payload misses:        %u\n", payload_misses);
 	seq_printf(m, "longest chain len:     %u\n", longest_chain);
 	seq_printf(m, "cachesize at longest:  %u\n", longest_chain_cachesize);
+	seq_printf(m, "checksum length:       %u\n", drc_csum_len);
+	nfsd_reply_cache_lookup_stats_show(m);
 	return 0;
 }
 
@@ -607,3 +794,21 @@ int nfsd_reply_cache_stats_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, nfsd_reply_cache_stats_show, NULL);
 }
+
+unsigned int nfsd_reply_cache_csum_len(void)
+{
+	return drc_csum_len;
+}
+
+/*
+ * Entries cached with a different checksum length won't match
+ * retransmissions anymore, so this is best set before starting nfsd.
+ */
+int nfsd_reply_cache_set_csum_len(unsigned int len)
+{
+	if (len > RC_CSUMLEN_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(drc_csum_len, len);
+	return 0;
+}
@@ -529,6 +529,24 @@ static int proc_pid_schedstat(struct seq_file *m, struct pid_namespace *ns,
 }
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Provides /proc/PID/wakeup_latency: one "<bucket start in ns> <count>"
+ * line per log2 bucket of the wakeup-to-run latency histogram.
+ */
+static int proc_pid_wakeup_latency(struct seq_file *m, struct pid_namespace *ns,
+				   struct pid *pid, struct task_struct *task)
+{
+	int i;
+
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		seq_printf(m, "%llu %u\n", sched_lat_hist_bucket_ns(i),
+			   task->sched_info.lat_hist.count[i]);
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_LATENCYTOP
 static int lstats_show_proc(struct seq_file *m, void *v)
 {
@@ -2833,6 +2851,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHED_INFO
 	ONE("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	ONE("wakeup_latency", S_IRUGO, proc_pid_wakeup_latency),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -3223,6 +3244,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHED_INFO
 	ONE("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	ONE("wakeup_latency", S_IRUGO, proc_pid_wakeup_latency),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
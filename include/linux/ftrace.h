@@ -548,7 +548,8 @@ extern int ftrace_make_nop(struct module *mod,
  */
 extern int ftrace_make_call(struct dyn_ftrace *rec, unsigned long addr);
 
-#ifdef CONFIG_DYNAMIC_FTRACE_WITH_REGS
+#if defined(CONFIG_DYNAMIC_FTRACE_WITH_REGS) || \
+	defined(ARCH_HAS_FTRACE_MODIFY_CALL)
 /**
  * ftrace_modify_call - convert from one addr to another (no nop)
  * @rec: the mcount call site record
@@ -69,6 +69,11 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	cpumask_var_t		pending_mask;
 #endif
+#ifdef CONFIG_IRQ_BALANCE
+	unsigned int		balance_count;	/* kstat_irqs() at last pass */
+	unsigned int		balance_delta;	/* interrupts during last pass */
+	unsigned long		balance_moved;	/* jiffies of last move */
+#endif
 #endif
 	unsigned long		threads_oneshot;
 	atomic_t		threads_active;
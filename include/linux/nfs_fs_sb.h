@@ -135,6 +135,12 @@ struct nfs_server {
 	unsigned int		caps;		/* server capabilities */
 	unsigned int		rsize;		/* read size */
 	unsigned int		rpages;		/* read size (in pages) */
+	spinlock_t		ra_lock;	/* protects the fields below */
+	unsigned int		ra_rpcs;	/* readahead, in READ RPCs */
+	unsigned int		ra_samples;
+	u32			read_rtt_min;	/* lowest recent READ RTT (usecs) */
+	u32			read_rtt_avg;	/* smoothed READ RTT (usecs) */
+	unsigned long		read_rtt_stamp;	/* when read_rtt_min was taken */
 	unsigned int		wsize;		/* write size */
 	unsigned int		wpages;		/* write size (in pages) */
 	unsigned int		wtmult;		/* server disk block size */
@@ -162,6 +162,9 @@ extern int kptr_restrict;
 
 extern void wake_up_klogd(void);
 
+extern void printk_emergency_begin(void);
+extern void printk_emergency_end(void);
+
 char *log_buf_addr_get(void);
 u32 log_buf_len_get(void);
 void log_buf_kexec_setup(void);
@@ -199,6 +202,14 @@ static inline void wake_up_klogd(void)
 {
 }
 
+static inline void printk_emergency_begin(void)
+{
+}
+
+static inline void printk_emergency_end(void)
+{
+}
+
 static inline char *log_buf_addr_get(void)
 {
 	return NULL;
@@ -868,6 +868,23 @@ extern struct user_struct root_user;
 struct backing_dev_info;
 struct reclaim_state;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Wakeup-to-run latency histogram with log2 buckets: bucket 0 counts
+ * delays below 1024ns, bucket n counts delays in [2^(n-1), 2^n) * 1024ns
+ * and the last bucket also counts everything above (~4s).
+ */
+#define SCHED_LAT_HIST_BUCKETS	24
+#define SCHED_LAT_HIST_SHIFT	10
+
+#define sched_lat_hist_bucket_ns(n) \
+	((n) ? 1ULL << ((n) - 1 + SCHED_LAT_HIST_SHIFT) : 0ULL)
+
+struct sched_lat_hist {
+	u32 count[SCHED_LAT_HIST_BUCKETS];
+};
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 #ifdef CONFIG_SCHED_INFO
 struct sched_info {
 	/* cumulative counters */
@@ -877,6 +894,13 @@ struct sched_info {
 	/* timestamps */
 	unsigned long long last_arrival,/* when we last ran on a cpu */
 			   last_queued;	/* when we were last queued to run */
+
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* wakeup-to-run latency */
+	int in_wakeup;		      /* woken up, not yet run */
+	unsigned long long wakeup_delay; /* delay accrued on previous rqs */
+	struct sched_lat_hist lat_hist;
+#endif
 };
 #endif /* CONFIG_SCHED_INFO */
 
@@ -1035,6 +1059,30 @@ extern int sched_domain_level_max;
 
 struct sched_group;
 
+/*
+ * State shared by all the sched_domains spanning the same CPUs at a
+ * cache sharing (SD_SHARE_PKG_RESOURCES) level.
+ */
+struct sched_domain_shared {
+	atomic_t	ref;
+	/*
+	 * Cores which were seen fully idle. This is only a hint for
+	 * select_idle_sibling(): a bit is set when the last SMT sibling
+	 * of a core goes idle and is cleared lazily when a wakeup finds
+	 * the core busy.
+	 *
+	 * NOTE: this field is variable length. (Allocated dynamically
+	 * by attaching extra space to the end of the structure,
+	 * depending on how many CPUs the kernel has booted up with)
+	 */
+	unsigned long	idle_cores[0];
+};
+
+static inline struct cpumask *sds_idle_cores(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_cores);
+}
+
 struct sched_domain {
 	/* These fields must be setup */
 	struct sched_domain *parent;	/* top domain must be null terminated */
@@ -1065,6 +1113,9 @@ struct sched_domain {
 	u64 max_newidle_lb_cost;
 	unsigned long next_decay_max_lb_cost;
 
+	/* select_idle_sibling() average scan cost, in ns */
+	u64 avg_scan_cost;
+
 #ifdef CONFIG_SCHEDSTATS
 	/* load_balance() stats */
 	unsigned int lb_count[CPU_MAX_IDLE_TYPES];
@@ -1095,6 +1146,12 @@ struct sched_domain {
 	unsigned int ttwu_wake_remote;
 	unsigned int ttwu_move_affine;
 	unsigned int ttwu_move_balance;
+
+	/* select_idle_sibling() stats */
+	unsigned int sis_search;
+	unsigned int sis_scanned;
+	unsigned int sis_failed;
+	unsigned int sis_idle_core;
 #endif
 #ifdef CONFIG_SCHED_DEBUG
 	char *name;
@@ -1103,6 +1160,7 @@ struct sched_domain {
 		void *private;		/* used during construction */
 		struct rcu_head rcu;	/* used during destruction */
 	};
+	struct sched_domain_shared *shared;
 
 	unsigned int span_weight;
 	/*
@@ -1136,6 +1194,7 @@ typedef int (*sched_domain_flags_f)(void);
 
 struct sd_data {
 	struct sched_domain **__percpu sd;
+	struct sched_domain_shared **__percpu sds;
 	struct sched_group **__percpu sg;
 	struct sched_group_capacity **__percpu sgc;
 };
@@ -3291,4 +3350,16 @@ static inline unsigned long rlimit_max(unsigned int limit)
 	return task_rlimit_max(current, limit);
 }
 
+#ifdef CONFIG_CPU_FREQ
+struct update_util_data {
+	void (*func)(struct update_util_data *data,
+		     u64 time, unsigned long util, unsigned long max);
+};
+
+void cpufreq_add_update_util_hook(int cpu, struct update_util_data *data,
+			void (*func)(struct update_util_data *data, u64 time,
+				     unsigned long util, unsigned long max));
+void cpufreq_remove_update_util_hook(int cpu);
+#endif /* CONFIG_CPU_FREQ */
+
 #endif
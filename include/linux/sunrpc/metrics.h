@@ -29,7 +29,18 @@
 #include <linux/ktime.h>
 #include <linux/spinlock.h>
 
-#define RPC_IOSTATS_VERS	"1.0"
+/*
+ * 1.01 adds the latency histogram section.  It stays clear of 1.1, which
+ * tools take to mean a different layout of the per-op statistics.
+ */
+#define RPC_IOSTATS_VERS	"1.01"
+
+/*
+ * RTT and execution time histograms use log2 buckets in microseconds:
+ * bucket 0 counts requests that took less than 2us, bucket n counts
+ * requests in [2^n, 2^(n+1)) usecs and the last bucket counts the rest.
+ */
+#define RPC_IOSTATS_HIST_BUCKETS	24
 
 struct rpc_iostats {
 	spinlock_t		om_lock;
@@ -65,6 +76,13 @@ struct rpc_iostats {
 	ktime_t			om_queue,	/* queued for xmit */
 				om_rtt,		/* RPC RTT */
 				om_execute;	/* RPC execution */
+
+	/*
+	 * Latency distributions, so that tools can see tail latency
+	 * rather than only the averages derived from the sums above.
+	 */
+	unsigned long		om_rtt_hist[RPC_IOSTATS_HIST_BUCKETS],
+				om_execute_hist[RPC_IOSTATS_HIST_BUCKETS];
 } ____cacheline_aligned;
 
 struct rpc_task;
@@ -7,6 +7,13 @@
 #include <linux/lockdep.h>
 #include <linux/tracepoint.h>
 
+/* flags for lock:contention_begin */
+#define LCB_F_SPIN	(1U << 0)
+#define LCB_F_READ	(1U << 1)
+#define LCB_F_WRITE	(1U << 2)
+#define LCB_F_RT	(1U << 3)
+#define LCB_F_MUTEX	(1U << 4)
+
 #ifdef CONFIG_LOCKDEP
 
 TRACE_EVENT(lock_acquire,
@@ -80,6 +87,57 @@ DEFINE_EVENT(lock, lock_acquired,
 #endif
 #endif
 
+/*
+ * Lock contention events, independent of lockdep: emitted on entry to and
+ * exit from the slowpath of the sleeping locks and of queued spinlocks.
+ */
+TRACE_EVENT(contention_begin,
+
+	TP_PROTO(void *lock, unsigned int flags),
+
+	TP_ARGS(lock, flags),
+
+	TP_STRUCT__entry(
+		__field(void *, lock_addr)
+		__field(unsigned int, flags)
+	),
+
+	TP_fast_assign(
+		__entry->lock_addr = lock;
+		__entry->flags = flags;
+	),
+
+	TP_printk("%p (flags=%s)", __entry->lock_addr,
+		  __print_flags(__entry->flags, "|",
+				{ LCB_F_SPIN,	"SPIN" },
+				{ LCB_F_READ,	"READ" },
+				{ LCB_F_WRITE,	"WRITE" },
+				{ LCB_F_RT,	"RT" },
+				{ LCB_F_MUTEX,	"MUTEX" }))
+);
+
+TRACE_EVENT(contention_end,
+
+	TP_PROTO(void *lock, int ret, u64 wait_ns),
+
+	TP_ARGS(lock, ret, wait_ns),
+
+	TP_STRUCT__entry(
+		__field(void *, lock_addr)
+		__field(int, ret)
+		__field(u64, wait_ns)
+	),
+
+	TP_fast_assign(
+		__entry->lock_addr = lock;
+		__entry->ret = ret;
+		__entry->wait_ns = wait_ns;
+	),
+
+	TP_printk("%p (ret=%d wait_ns=%llu)", __entry->lock_addr,
+		  __entry->ret, (unsigned long long)__entry->wait_ns)
+);
+
 #endif /* _TRACE_LOCK_H */
 
 /* This part must be outside protection */
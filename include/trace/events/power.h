@@ -120,6 +120,58 @@ DEFINE_EVENT(cpu, cpu_frequency,
 	TP_ARGS(frequency, cpu_id)
 );
 
+TRACE_EVENT(cpufreq_schedutil_update,
+
+	TP_PROTO(unsigned int cpu_id, unsigned long util, unsigned long max,
+		 unsigned int next_freq),
+
+	TP_ARGS(cpu_id, util, max, next_freq),
+
+	TP_STRUCT__entry(
+		__field(u32, cpu_id)
+		__field(unsigned long, util)
+		__field(unsigned long, max)
+		__field(u32, next_freq)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->util = util;
+		__entry->max = max;
+		__entry->next_freq = next_freq;
+	),
+
+	TP_printk("cpu_id=%lu util=%lu max=%lu next_freq=%lu",
+		  (unsigned long)__entry->cpu_id,
+		  __entry->util,
+		  __entry->max,
+		  (unsigned long)__entry->next_freq)
+);
+
+TRACE_EVENT(cpufreq_schedutil_change,
+
+	TP_PROTO(unsigned int cpu_id, unsigned int freq, u64 latency_ns),
+
+	TP_ARGS(cpu_id, freq, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(u32, cpu_id)
+		__field(u32, freq)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->freq = freq;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("cpu_id=%lu freq=%lu latency_ns=%llu",
+		  (unsigned long)__entry->cpu_id,
+		  (unsigned long)__entry->freq,
+		  (unsigned long long)__entry->latency_ns)
+);
+
 TRACE_EVENT(device_pm_callback_start,
 
 	TP_PROTO(struct device *dev, const char *pm_ops, int event),
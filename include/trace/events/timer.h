@@ -360,6 +360,40 @@ TRACE_EVENT(tick_stop,
 );
 #endif
 
+#ifdef CONFIG_NO_HZ_FULL
+/**
+ * isolation_violation - called when a full dynticks CPU is disturbed
+ * @cpu:	the full dynticks CPU
+ * @what:	the kind of disturbance, e.g. "timer" or "kick"
+ * @func:	the timer callback or the caller of the disturbance
+ *
+ * Reports work which the kernel does on, or forces onto, a CPU isolated
+ * with nohz_full=. Hist triggers on this event, keyed by cpu, what and
+ * func.sym, give a summary of the sources of noise.
+ */
+TRACE_EVENT(isolation_violation,
+
+	TP_PROTO(int cpu, const char *what, void *func),
+
+	TP_ARGS(cpu, what, func),
+
+	TP_STRUCT__entry(
+		__field( int,		cpu	)
+		__string( what,		what	)
+		__field( void *,	func	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu	= cpu;
+		__assign_str(what, what);
+		__entry->func	= func;
+	),
+
+	TP_printk("cpu=%d what=%s func=%pf",
+		  __entry->cpu, __get_str(what), __entry->func)
+);
+#endif
+
 #endif /*  _TRACE_TIMER_H */
 
 /* This part must be outside protection */
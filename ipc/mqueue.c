@@ -68,7 +68,10 @@ struct mqueue_inode_info {
 	wait_queue_head_t wait_q;
 
 	struct rb_root msg_tree;
+	struct rb_node *msg_tree_rightmost;	/* highest priority leaf */
 	struct posix_msg_tree_node *node_cache;
+	struct list_head msg_cache;	/* recycled messages, see mq_load_msg() */
+	unsigned int msg_cache_nr;
 	struct mq_attr attr;
 
 	struct sigevent notify;
@@ -121,6 +124,18 @@ static int msg_insert(struct msg_msg *msg, struct mqueue_inode_info *info)
 {
 	struct rb_node **p, *parent = NULL;
 	struct posix_msg_tree_node *leaf;
+	bool rightmost = true;
+
+	/*
+	 * Most queues only ever see a single priority, or at least mostly
+	 * the highest one: that leaf is cached, so no tree walk is needed.
+	 */
+	if (likely(info->msg_tree_rightmost)) {
+		leaf = rb_entry(info->msg_tree_rightmost,
+				struct posix_msg_tree_node, rb_node);
+		if (likely(leaf->priority == msg->m_type))
+			goto insert_msg;
+	}
 
 	p = &info->msg_tree.rb_node;
 	while (*p) {
@@ -129,9 +144,10 @@ static int msg_insert(struct msg_msg *msg, struct mqueue_inode_info *info)
 
 		if (likely(leaf->priority == msg->m_type))
 			goto insert_msg;
-		else if (msg->m_type < leaf->priority)
+		else if (msg->m_type < leaf->priority) {
 			p = &(*p)->rb_left;
-		else
+			rightmost = false;
+		} else
 			p = &(*p)->rb_right;
 	}
 	if (info->node_cache) {
@@ -144,6 +160,8 @@ static int msg_insert(struct msg_msg *msg, struct mqueue_inode_info *info)
 		INIT_LIST_HEAD(&leaf->msg_list);
 	}
 	leaf->priority = msg->m_type;
+	if (rightmost)
+		info->msg_tree_rightmost = &leaf->rb_node;
 	rb_link_node(&leaf->rb_node, parent, p);
 	rb_insert_color(&leaf->rb_node, &info->msg_tree);
 insert_msg:
@@ -153,23 +171,35 @@ insert_msg:
 	return 0;
 }
 
+static void msg_tree_erase(struct posix_msg_tree_node *leaf,
+			   struct mqueue_inode_info *info)
+{
+	struct rb_node *node = &leaf->rb_node;
+
+	if (info->msg_tree_rightmost == node)
+		info->msg_tree_rightmost = rb_prev(node);
+
+	rb_erase(node, &info->msg_tree);
+	if (info->node_cache) {
+		kfree(leaf);
+	} else {
+		info->node_cache = leaf;
+	}
+}
+
 static inline struct msg_msg *msg_get(struct mqueue_inode_info *info)
 {
-	struct rb_node **p, *parent = NULL;
+	struct rb_node *parent = NULL;
 	struct posix_msg_tree_node *leaf;
 	struct msg_msg *msg;
 
 try_again:
-	p = &info->msg_tree.rb_node;
-	while (*p) {
-		parent = *p;
-		/*
-		 * During insert, low priorities go to the left and high to the
-		 * right.  On receive, we want the highest priorities first, so
-		 * walk all the way to the right.
-		 */
-		p = &(*p)->rb_right;
-	}
+	/*
+	 * During insert, low priorities go to the left and high to the
+	 * right.  On receive, we want the highest priorities first, which
+	 * is the cached rightmost leaf.
+	 */
+	parent = info->msg_tree_rightmost;
 	if (!parent) {
 		if (info->attr.mq_curmsgs) {
 			pr_warn_once("Inconsistency in POSIX message queue, "
@@ -184,31 +214,81 @@ try_again:
 		pr_warn_once("Inconsistency in POSIX message queue, "
 			     "empty leaf node but we haven't implemented "
 			     "lazy leaf delete!\n");
-		rb_erase(&leaf->rb_node, &info->msg_tree);
-		if (info->node_cache) {
-			kfree(leaf);
-		} else {
-			info->node_cache = leaf;
-		}
+		msg_tree_erase(leaf, info);
 		goto try_again;
 	} else {
 		msg = list_first_entry(&leaf->msg_list,
 				       struct msg_msg, m_list);
 		list_del(&msg->m_list);
-		if (list_empty(&leaf->msg_list)) {
-			rb_erase(&leaf->rb_node, &info->msg_tree);
-			if (info->node_cache) {
-				kfree(leaf);
-			} else {
-				info->node_cache = leaf;
-			}
-		}
+		if (list_empty(&leaf->msg_list))
+			msg_tree_erase(leaf, info);
 	}
 	info->attr.mq_curmsgs--;
 	info->qsize -= msg->m_ts;
 	return msg;
 }
 
+/*
+ * Messages of queues with a mq_msgsize up to the default are allocated for
+ * the full mq_msgsize, so that a message freed by mq_timedreceive() can be
+ * recycled by the next mq_timedsend() instead of going through the
+ * allocator again.  The memory was already charged to the queue's owner.
+ */
+#define MQ_MSG_CACHE_MAX	8
+
+static inline bool mq_msg_cacheable(struct mqueue_inode_info *info)
+{
+	return info->attr.mq_msgsize <= DFLT_MSGSIZE;
+}
+
+static struct msg_msg *mq_load_msg(struct mqueue_inode_info *info,
+				   const void __user *src, size_t len)
+{
+	struct msg_msg *msg = NULL;
+	int err;
+
+	if (!mq_msg_cacheable(info))
+		return load_msg(src, len);
+
+	spin_lock(&info->lock);
+	if (!list_empty(&info->msg_cache)) {
+		msg = list_first_entry(&info->msg_cache, struct msg_msg, m_list);
+		list_del(&msg->m_list);
+		info->msg_cache_nr--;
+	}
+	spin_unlock(&info->lock);
+
+	if (!msg) {
+		msg = alloc_msg(info->attr.mq_msgsize);
+		if (!msg)
+			return ERR_PTR(-ENOMEM);
+	}
+
+	err = fill_msg(msg, src, len);
+	if (err) {
+		free_msg(msg);
+		return ERR_PTR(err);
+	}
+	return msg;
+}
+
+static void mq_free_msg(struct mqueue_inode_info *info, struct msg_msg *msg)
+{
+	if (mq_msg_cacheable(info)) {
+		spin_lock(&info->lock);
+		if (info->msg_cache_nr < min_t(unsigned int, MQ_MSG_CACHE_MAX,
+					       info->attr.mq_maxmsg)) {
+			list_add(&msg->m_list, &info->msg_cache);
+			info->msg_cache_nr++;
+			msg = NULL;
+		}
+		spin_unlock(&info->lock);
+		if (!msg)
+			return;
+	}
+	free_msg(msg);
+}
+
 static struct inode *mqueue_get_inode(struct super_block *sb,
 		struct ipc_namespace *ipc_ns, umode_t mode,
 		struct mq_attr *attr)
@@ -244,7 +324,10 @@ static struct inode *mqueue_get_inode(struct super_block *sb,
 		info->qsize = 0;
 		info->user = NULL;	/* set when all is ok */
 		info->msg_tree = RB_ROOT;
+		info->msg_tree_rightmost = NULL;
 		info->node_cache = NULL;
+		INIT_LIST_HEAD(&info->msg_cache);
+		info->msg_cache_nr = 0;
 		memset(&info->attr, 0, sizeof(info->attr));
 		info->attr.mq_maxmsg = min(ipc_ns->mq_msg_max,
 					   ipc_ns->mq_msg_default);
@@ -385,6 +468,8 @@ static void mqueue_evict_inode(struct inode *inode)
 	spin_lock(&info->lock);
 	while ((msg = msg_get(info)) != NULL)
 		list_add_tail(&msg->m_list, &tmp_msg);
+	list_splice_tail_init(&info->msg_cache, &tmp_msg);
+	info->msg_cache_nr = 0;
 	kfree(info->node_cache);
 	spin_unlock(&info->lock);
 
@@ -1016,7 +1101,7 @@ SYSCALL_DEFINE5(mq_timedsend, mqd_t, mqdes, const char __user *, u_msg_ptr,
 
 	/* First try to allocate memory, before doing anything with
 	 * existing queues. */
-	msg_ptr = load_msg(u_msg_ptr, msg_len);
+	msg_ptr = mq_load_msg(info, u_msg_ptr, msg_len);
 	if (IS_ERR(msg_ptr)) {
 		ret = PTR_ERR(msg_ptr);
 		goto out_fput;
@@ -1076,7 +1161,7 @@ out_unlock:
 	wake_up_q(&wake_q);
 out_free:
 	if (ret)
-		free_msg(msg_ptr);
+		mq_free_msg(info, msg_ptr);
 out_fput:
 	fdput(f);
 out:
@@ -1180,7 +1265,7 @@ SYSCALL_DEFINE5(mq_timedreceive, mqd_t, mqdes, char __user *, u_msg_ptr,
 			store_msg(u_msg_ptr, msg_ptr, msg_ptr->m_ts)) {
 			ret = -EFAULT;
 		}
-		free_msg(msg_ptr);
+		mq_free_msg(info, msg_ptr);
 	}
 out_fput:
 	fdput(f);
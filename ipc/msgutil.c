@@ -48,8 +48,7 @@ struct msg_msgseg {
 #define DATALEN_MSG	((size_t)PAGE_SIZE-sizeof(struct msg_msg))
 #define DATALEN_SEG	((size_t)PAGE_SIZE-sizeof(struct msg_msgseg))
 
-
-static struct msg_msg *alloc_msg(size_t len)
+struct msg_msg *alloc_msg(size_t len)
 {
 	struct msg_msg *msg;
 	struct msg_msgseg **pseg;
@@ -87,38 +86,48 @@ out_err:
 	return NULL;
 }
 
-struct msg_msg *load_msg(const void __user *src, size_t len)
+/*
+ * Copy @len bytes from user space into @msg and label it for the LSM.
+ * @msg must come from alloc_msg() for at least @len bytes. It may be a
+ * recycled message, in which case its previous label is dropped first.
+ */
+int fill_msg(struct msg_msg *msg, const void __user *src, size_t len)
 {
-	struct msg_msg *msg;
 	struct msg_msgseg *seg;
-	int err = -EFAULT;
 	size_t alen;
 
-	msg = alloc_msg(len);
-	if (msg == NULL)
-		return ERR_PTR(-ENOMEM);
-
 	alen = min(len, DATALEN_MSG);
 	if (copy_from_user(msg + 1, src, alen))
-		goto out_err;
+		return -EFAULT;
 
 	for (seg = msg->next; seg != NULL; seg = seg->next) {
 		len -= alen;
 		src = (char __user *)src + alen;
 		alen = min(len, DATALEN_SEG);
 		if (copy_from_user(seg + 1, src, alen))
-			goto out_err;
+			return -EFAULT;
 	}
 
-	err = security_msg_msg_alloc(msg);
-	if (err)
-		goto out_err;
+	security_msg_msg_free(msg);
+	return security_msg_msg_alloc(msg);
+}
 
-	return msg;
+struct msg_msg *load_msg(const void __user *src, size_t len)
+{
+	struct msg_msg *msg;
+	int err;
 
-out_err:
-	free_msg(msg);
-	return ERR_PTR(err);
+	msg = alloc_msg(len);
+	if (msg == NULL)
+		return ERR_PTR(-ENOMEM);
+
+	err = fill_msg(msg, src, len);
+	if (err) {
+		free_msg(msg);
+		return ERR_PTR(err);
+	}
+
+	return msg;
 }
 #ifdef CONFIG_CHECKPOINT_RESTORE
 struct msg_msg *copy_msg(struct msg_msg *src, struct msg_msg *dst)
@@ -149,6 +149,8 @@ int ipc_parse_version(int *cmd);
 #endif
 
 extern void free_msg(struct msg_msg *msg);
+extern struct msg_msg *alloc_msg(size_t len);
+extern int fill_msg(struct msg_msg *msg, const void __user *src, size_t len);
 extern struct msg_msg *load_msg(const void __user *src, size_t len);
 extern struct msg_msg *copy_msg(struct msg_msg *src, struct msg_msg *dst);
 extern int store_msg(void __user *dest, struct msg_msg *msg, size_t len);
@@ -0,0 +1,238 @@
+/*
+ * linux/kernel/irq/balance.c
+ *
+ * In-kernel interrupt balancing.
+ *
+ * Interrupts whose affinity has not been set explicitly, by userspace or
+ * by a driver, are spread across the online CPUs based on the interrupt
+ * counts seen over the last interval. Each pass moves at most a few
+ * interrupts from the busiest CPU to the least busy one, and only when
+ * the imbalance exceeds irqbalance.threshold percent. An interrupt which
+ * has been moved is left alone for a few intervals, so that interrupts
+ * do not bounce between CPUs. Threaded handlers follow the affinity of
+ * their interrupt and are spread along with it.
+ *
+ * The affinity change itself goes through irq_set_affinity_locked(), so
+ * interrupts which cannot be moved from process context are migrated
+ * from the next interrupt, as with /proc/irq/N/smp_affinity.
+ */
+
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/kernel_stat.h>
+#include <linux/moduleparam.h>
+#include <linux/cpu.h>
+#include <linux/slab.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+
+#include "internals.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "irqbalance."
+
+/* Maximum number of interrupts moved per pass */
+#define IRQ_BALANCE_MAX_MOVES		4
+
+/* Intervals during which a moved interrupt is not considered again */
+#define IRQ_BALANCE_HOLDOFF		10
+
+/* CPUs taking fewer interrupts per second than this are not balanced */
+#define IRQ_BALANCE_MIN_RATE		100
+
+static unsigned int irq_balance_interval_ms = 1000;
+static unsigned int irq_balance_threshold = 25;
+module_param_named(threshold, irq_balance_threshold, uint, 0644);
+
+static unsigned long *irq_balance_load;
+static DEFINE_PER_CPU(unsigned int, irq_balance_last_sum);
+
+static void irq_balance_work_fn(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(irq_balance_work, irq_balance_work_fn);
+
+static bool irq_balance_candidate(unsigned int irq, struct irq_desc *desc)
+{
+	return desc->action && irq_can_set_affinity(irq) &&
+	       !irqd_has_set(&desc->irq_data, IRQD_AFFINITY_SET);
+}
+
+/* The CPU an interrupt is currently delivered to, approximately */
+static unsigned int irq_balance_cpu(struct irq_desc *desc)
+{
+	return cpumask_first_and(desc->irq_common_data.affinity,
+				 cpu_online_mask);
+}
+
+/*
+ * Pick the least loaded online housekeeping CPU for @desc, preferring the
+ * CPUs of its node. Full dynticks CPUs are never chosen.
+ */
+static unsigned int irq_balance_target(struct irq_desc *desc)
+{
+	const struct cpumask *mask = cpu_online_mask;
+	int node = irq_desc_get_node(desc);
+	unsigned int cpu, target = nr_cpu_ids;
+
+	if (node != NUMA_NO_NODE &&
+	    cpumask_intersects(cpumask_of_node(node), cpu_online_mask))
+		mask = cpumask_of_node(node);
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask) {
+		if (!cpumask_test_cpu(cpu, irq_default_affinity) ||
+		    !is_housekeeping_cpu(cpu))
+			continue;
+		if (target >= nr_cpu_ids ||
+		    irq_balance_load[cpu] < irq_balance_load[target])
+			target = cpu;
+	}
+	return target;
+}
+
+/*
+ * Move the interrupt of the busiest CPU which narrows the gap to its
+ * target CPU the most. Return false if there is nothing worth moving.
+ */
+static bool irq_balance_one(unsigned long min_load)
+{
+	struct irq_desc *desc, *best = NULL;
+	unsigned int irq, cpu, busiest = nr_cpu_ids, target = 0;
+	unsigned long gap, flags;
+
+	for_each_online_cpu(cpu) {
+		if (busiest >= nr_cpu_ids ||
+		    irq_balance_load[cpu] > irq_balance_load[busiest])
+			busiest = cpu;
+	}
+	if (busiest >= nr_cpu_ids || irq_balance_load[busiest] < min_load)
+		return false;
+
+	for_each_active_irq(irq) {
+		desc = irq_to_desc(irq);
+		if (!desc || !desc->balance_delta ||
+		    !irq_balance_candidate(irq, desc) ||
+		    irq_balance_cpu(desc) != busiest)
+			continue;
+		if (time_before(jiffies, desc->balance_moved +
+				IRQ_BALANCE_HOLDOFF *
+				msecs_to_jiffies(irq_balance_interval_ms)))
+			continue;
+
+		cpu = irq_balance_target(desc);
+		if (cpu >= nr_cpu_ids || cpu == busiest)
+			continue;
+
+		/*
+		 * Hysteresis: only act on a significant imbalance, and only
+		 * move an interrupt which makes it smaller instead of
+		 * reversing it: moving delta interrupts shrinks the gap by
+		 * twice that, as the target gains what the busiest CPU loses.
+		 */
+		gap = irq_balance_load[busiest] - irq_balance_load[cpu];
+		if (gap * 100 <= irq_balance_load[busiest] * irq_balance_threshold)
+			continue;
+		if (2 * desc->balance_delta >= gap)
+			continue;
+
+		if (!best || desc->balance_delta > best->balance_delta) {
+			best = desc;
+			target = cpu;
+		}
+	}
+	if (!best)
+		return false;
+
+	raw_spin_lock_irqsave(&best->lock, flags);
+	if (!irqd_has_set(&best->irq_data, IRQD_AFFINITY_SET)) {
+		irq_set_affinity_locked(&best->irq_data, cpumask_of(target),
+					false);
+		/*
+		 * Not an explicit setting, keep balancing this interrupt.
+		 * irq_set_affinity_locked() sets the flag even when the
+		 * move fails.
+		 */
+		irqd_clear(&best->irq_data, IRQD_AFFINITY_SET);
+	}
+	raw_spin_unlock_irqrestore(&best->lock, flags);
+
+	best->balance_moved = jiffies;
+	irq_balance_load[busiest] -= best->balance_delta;
+	irq_balance_load[target] += best->balance_delta;
+	return true;
+}
+
+static void irq_balance(void)
+{
+	struct irq_desc *desc;
+	unsigned int irq, count, moves = 0;
+	unsigned long min_load;
+	int cpu;
+
+	get_online_cpus();
+	irq_lock_sparse();
+
+	for_each_online_cpu(cpu) {
+		unsigned int sum = kstat_cpu_irqs_sum(cpu);
+
+		irq_balance_load[cpu] = sum - per_cpu(irq_balance_last_sum, cpu);
+		per_cpu(irq_balance_last_sum, cpu) = sum;
+	}
+
+	for_each_active_irq(irq) {
+		desc = irq_to_desc(irq);
+		if (!desc)
+			continue;
+		count = kstat_irqs(irq);
+		desc->balance_delta = count - desc->balance_count;
+		desc->balance_count = count;
+	}
+
+	min_load = IRQ_BALANCE_MIN_RATE * irq_balance_interval_ms / MSEC_PER_SEC;
+	while (moves < IRQ_BALANCE_MAX_MOVES && irq_balance_one(min_load))
+		moves++;
+
+	irq_unlock_sparse();
+	put_online_cpus();
+}
+
+static void irq_balance_work_fn(struct work_struct *work)
+{
+	unsigned int interval = READ_ONCE(irq_balance_interval_ms);
+
+	if (!interval)
+		return;
+
+	irq_balance();
+	queue_delayed_work(system_unbound_wq, &irq_balance_work,
+			   msecs_to_jiffies(interval));
+}
+
+static int irq_balance_set_interval(const char *val,
+				    const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	/* Restart the balancer with the new interval once it is set up */
+	if (!ret && irq_balance_load)
+		mod_delayed_work(system_unbound_wq, &irq_balance_work, 0);
+	return ret;
+}
+
+static const struct kernel_param_ops irq_balance_interval_ops = {
+	.set = irq_balance_set_interval,
+	.get = param_get_uint,
+};
+module_param_cb(interval_ms, &irq_balance_interval_ops,
+		&irq_balance_interval_ms, 0644);
+
+static int __init irq_balance_init(void)
+{
+	irq_balance_load = kcalloc(nr_cpu_ids, sizeof(*irq_balance_load),
+				   GFP_KERNEL);
+	if (!irq_balance_load)
+		return -ENOMEM;
+
+	queue_delayed_work(system_unbound_wq, &irq_balance_work,
+			   msecs_to_jiffies(irq_balance_interval_ms));
+	return 0;
+}
+late_initcall(irq_balance_init);
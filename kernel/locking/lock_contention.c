@@ -0,0 +1,244 @@
+/*
+ * Lightweight lock contention statistics
+ *
+ * Aggregates the lock:contention_end tracepoint per lock address, without
+ * requiring lockdep. Collection is controlled through
+ * /sys/kernel/debug/lock_contention:
+ *
+ *   echo 1 > lock_contention	clear the statistics and start collecting
+ *   echo 0 > lock_contention	stop collecting
+ *   cat lock_contention	show the statistics, most waited on first
+ *
+ * While stopped, the probe is not registered and the slowpath hooks are
+ * patched out branches.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include <trace/events/lock.h>
+
+#define LC_HASH_BITS	8
+#define LC_HASH_SIZE	(1 << LC_HASH_BITS)
+#define LC_MAX_PROBE	8
+
+struct lock_contention_stat {
+	void	*lock;
+	u64	count;
+	u64	total_ns;
+	u64	max_ns;
+};
+
+/*
+ * One open addressed table per cpu, updated with interrupts disabled so
+ * that the probe needs no locking of its own; it may well be running
+ * from within a spinlock slowpath. Locks that find no free slot within
+ * LC_MAX_PROBE entries are counted as dropped.
+ */
+struct lock_contention_table {
+	struct lock_contention_stat	stats[LC_HASH_SIZE];
+	u64				dropped;
+};
+
+static DEFINE_MUTEX(lock_contention_mutex);
+static struct lock_contention_table __percpu *lock_contention_tables;
+static bool lock_contention_enabled;
+
+static void lock_contention_probe(void *data, void *lock, int ret,
+				  u64 wait_ns)
+{
+	struct lock_contention_table __percpu *tables = data;
+	struct lock_contention_table *t;
+	struct lock_contention_stat *s;
+	unsigned long flags;
+	unsigned int i, idx;
+
+	if (in_nmi())
+		return;
+
+	local_irq_save(flags);
+	t = this_cpu_ptr(tables);
+	idx = hash_ptr(lock, LC_HASH_BITS);
+	for (i = 0; i < LC_MAX_PROBE; i++) {
+		s = &t->stats[(idx + i) & (LC_HASH_SIZE - 1)];
+		if (s->lock == lock || !s->lock) {
+			s->lock = lock;
+			s->count++;
+			s->total_ns += wait_ns;
+			if (wait_ns > s->max_ns)
+				s->max_ns = wait_ns;
+			goto out;
+		}
+	}
+	t->dropped++;
+out:
+	local_irq_restore(flags);
+}
+
+static int lock_contention_set(bool enable)
+{
+	int cpu, ret = 0;
+
+	mutex_lock(&lock_contention_mutex);
+	/*
+	 * Restarting also clears the statistics, so the probe has to be
+	 * out of the way before the tables are wiped under it.
+	 */
+	if (lock_contention_enabled) {
+		unregister_trace_contention_end(lock_contention_probe,
+						lock_contention_tables);
+		tracepoint_synchronize_unregister();
+		lock_contention_enabled = false;
+	}
+	if (!enable)
+		goto out;
+
+	if (!lock_contention_tables) {
+		lock_contention_tables =
+			alloc_percpu(struct lock_contention_table);
+		if (!lock_contention_tables) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(lock_contention_tables, cpu), 0,
+		       sizeof(struct lock_contention_table));
+
+	ret = register_trace_contention_end(lock_contention_probe,
+					    lock_contention_tables);
+	if (!ret)
+		lock_contention_enabled = true;
+out:
+	mutex_unlock(&lock_contention_mutex);
+	return ret;
+}
+
+static int lock_contention_cmp_lock(const void *a, const void *b)
+{
+	const struct lock_contention_stat *sa = a, *sb = b;
+
+	if (sa->lock == sb->lock)
+		return 0;
+	return sa->lock < sb->lock ? -1 : 1;
+}
+
+static int lock_contention_cmp_wait(const void *a, const void *b)
+{
+	const struct lock_contention_stat *sa = a, *sb = b;
+
+	if (sa->total_ns == sb->total_ns)
+		return 0;
+	return sa->total_ns > sb->total_ns ? -1 : 1;
+}
+
+/*
+ * Fold the per-cpu tables into one entry per lock. The tables may be
+ * updated concurrently, so the numbers are only as consistent as the
+ * individual loads.
+ */
+static int lock_contention_show(struct seq_file *m, void *v)
+{
+	struct lock_contention_stat *stats, *s;
+	u64 dropped = 0;
+	int cpu, i, n = 0, nr;
+
+	mutex_lock(&lock_contention_mutex);
+	seq_printf(m, "enabled: %d\n", lock_contention_enabled);
+	if (!lock_contention_tables)
+		goto out;
+
+	stats = vmalloc(sizeof(*stats) * LC_HASH_SIZE * num_possible_cpus());
+	if (!stats) {
+		mutex_unlock(&lock_contention_mutex);
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct lock_contention_table *t;
+
+		t = per_cpu_ptr(lock_contention_tables, cpu);
+		dropped += READ_ONCE(t->dropped);
+		for (i = 0; i < LC_HASH_SIZE; i++) {
+			s = &t->stats[i];
+			if (!READ_ONCE(s->lock))
+				continue;
+			stats[n++] = *s;
+		}
+	}
+
+	sort(stats, n, sizeof(*stats), lock_contention_cmp_lock, NULL);
+	for (i = 0, nr = 0; i < n; i++) {
+		s = &stats[nr];
+		if (nr && stats[i].lock == stats[nr - 1].lock) {
+			s = &stats[nr - 1];
+			s->count += stats[i].count;
+			s->total_ns += stats[i].total_ns;
+			s->max_ns = max(s->max_ns, stats[i].max_ns);
+			continue;
+		}
+		*s = stats[i];
+		nr++;
+	}
+	sort(stats, nr, sizeof(*stats), lock_contention_cmp_wait, NULL);
+
+	seq_printf(m, "dropped: %llu\n", dropped);
+	seq_printf(m, "%12s %16s %14s %14s  %s\n",
+		   "contended", "total_ns", "max_ns", "avg_ns", "lock");
+	for (i = 0; i < nr; i++) {
+		s = &stats[i];
+		seq_printf(m, "%12llu %16llu %14llu %14llu  %pS\n",
+			   s->count, s->total_ns, s->max_ns,
+			   div64_u64(s->total_ns, s->count), s->lock);
+	}
+	vfree(stats);
+out:
+	mutex_unlock(&lock_contention_mutex);
+	return 0;
+}
+
+static int lock_contention_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lock_contention_show, NULL);
+}
+
+static ssize_t lock_contention_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *pos)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(buf, count, &enable);
+	if (ret)
+		return ret;
+
+	ret = lock_contention_set(enable);
+	return ret ? ret : count;
+}
+
+static const struct file_operations lock_contention_fops = {
+	.open		= lock_contention_open,
+	.read		= seq_read,
+	.write		= lock_contention_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lock_contention_init(void)
+{
+	debugfs_create_file("lock_contention", S_IRUSR | S_IWUSR, NULL, NULL,
+			    &lock_contention_fops);
+	return 0;
+}
+late_initcall(lock_contention_init);
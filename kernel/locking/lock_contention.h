@@ -0,0 +1,31 @@
+#ifndef __LOCKING_LOCK_CONTENTION_H
+#define __LOCKING_LOCK_CONTENTION_H
+
+#include <linux/sched.h>
+#include <trace/events/lock.h>
+
+/*
+ * Slowpath hooks for the lock:contention_begin/end tracepoints.  The
+ * begin hook returns a timestamp, taken only while contention_end is
+ * enabled, from which the end hook reports the time spent waiting.
+ * When neither tracepoint is enabled both reduce to patched out
+ * branches.
+ */
+static __always_inline u64 lock_contention_begin(void *lock,
+						 unsigned int flags)
+{
+	trace_contention_begin(lock, flags);
+	if (trace_contention_end_enabled())
+		return local_clock();
+	return 0;
+}
+
+static __always_inline void lock_contention_end(void *lock, u64 start,
+						int ret)
+{
+	if (trace_contention_end_enabled())
+		trace_contention_end(lock, ret,
+				     start ? local_clock() - start : 0);
+}
+
+#endif /* __LOCKING_LOCK_CONTENTION_H */
@@ -112,6 +112,7 @@ struct lock_torture_cxt {
 	struct lock_torture_ops *cur_ops;
 	struct lock_stress_stats *lwsa; /* writer statistics */
 	struct lock_stress_stats *lrsa; /* reader statistics */
+	unsigned long start_time; /* jiffies at start of test */
 };
 static struct lock_torture_cxt cxt = { 0, 0, false,
 				       ATOMIC_INIT(0),
@@ -649,6 +650,7 @@ static void __torture_print_stats(char *page,
 	long max = 0;
 	long min = statp[0].n_lock_acquired;
 	long long sum = 0;
+	unsigned int msecs = jiffies_to_msecs(jiffies - cxt.start_time);
 
 	n_stress = write ? cxt.nrealwriters_stress : cxt.nrealreaders_stress;
 	for (i = 0; i < n_stress; i++) {
@@ -661,10 +663,11 @@ static void __torture_print_stats(char *page,
 			min = statp[i].n_lock_acquired;
 	}
 	page += sprintf(page,
-			"%s:  Total: %lld  Max/Min: %ld/%ld %s  Fail: %d %s\n",
+			"%s:  Total: %lld  Max/Min: %ld/%ld %s  Fail: %d %s  Rate: %llu/s\n",
 			write ? "Writes" : "Reads ",
 			sum, max, min, max / 2 > min ? "???" : "",
-			fail, fail ? "!!!" : "");
+			fail, fail ? "!!!" : "",
+			msecs ? div_u64(sum * MSEC_PER_SEC, msecs) : 0ULL);
 	if (fail)
 		atomic_inc(&cxt.n_lock_torture_errors);
 }
@@ -881,6 +884,7 @@ static int __init lock_torture_init(void)
 		}
 	}
 	lock_torture_print_module_parms(cxt.cur_ops, "Start of test");
+	cxt.start_time = jiffies;
 
 	/* Prepare torture context. */
 	if (onoff_interval > 0) {
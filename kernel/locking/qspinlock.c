@@ -67,6 +67,7 @@
  */
 
 #include "mcs_spinlock.h"
+#include "lock_contention.h"
 
 #ifdef CONFIG_PARAVIRT_SPINLOCKS
 #define MAX_NODES	8
@@ -342,15 +343,18 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 {
 	struct mcs_spinlock *prev, *next, *node;
 	u32 new, old, tail;
+	u64 start;
 	int idx;
 
 	BUILD_BUG_ON(CONFIG_NR_CPUS >= (1U << _Q_TAIL_CPU_BITS));
 
+	start = lock_contention_begin(lock, LCB_F_SPIN);
+
 	if (pv_enabled())
 		goto queue;
 
 	if (virt_spin_lock(lock))
-		return;
+		goto out;
 
 	/*
 	 * wait for in-progress pending->locked hand-overs
@@ -390,7 +394,7 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	 * we won the trylock
 	 */
 	if (new == _Q_LOCKED_VAL)
-		return;
+		goto out;
 
 	/*
 	 * we're pending, wait for the owner to go away.
@@ -411,7 +415,7 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	 * *,1,0 -> *,0,1
 	 */
 	clear_pending_set_locked(lock);
-	return;
+	goto out;
 
 	/*
 	 * End of pending bit optimistic spinning and beginning of MCS
@@ -515,6 +519,8 @@ release:
 	 * release the node
 	 */
 	this_cpu_dec(mcs_nodes[0].count);
+out:
+	lock_contention_end(lock, start, 0);
 }
 EXPORT_SYMBOL(queued_spin_lock_slowpath);
 
@@ -18,6 +18,7 @@
 #include <linux/timer.h>
 
 #include "rtmutex_common.h"
+#include "lock_contention.h"
 
 /*
  * lock->owner state tracking:
@@ -1157,6 +1158,76 @@ void rt_mutex_adjust_pi(struct task_struct *task)
 				   next_lock, NULL, task);
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Upper bound for one spin. The owner of a PI futex holds the rt_mutex
+ * while it runs in user space, so being on a cpu does not mean that it
+ * is about to release the lock.
+ */
+#define RT_MUTEX_SPIN_MAX_NS	(50 * NSEC_PER_USEC)
+
+/*
+ * Adaptive spinning: an owner which is running on another cpu is likely
+ * to release the lock soon, so the top waiter busy waits for that rather
+ * than paying for a sleep and a wakeup.  Returns true if the owner
+ * changed and the lock should be retried, false if the waiter should
+ * schedule out.
+ */
+static bool rt_mutex_spin_on_owner(struct rt_mutex *lock,
+				   struct rt_mutex_waiter *waiter,
+				   struct task_struct *owner, int state,
+				   struct hrtimer_sleeper *timeout)
+{
+	u64 deadline = local_clock() + RT_MUTEX_SPIN_MAX_NS;
+	bool ret = true;
+
+	rcu_read_lock();
+	for (;;) {
+		/* Owner changed, try to take the lock again. */
+		if (owner != rt_mutex_owner(lock))
+			break;
+		/*
+		 * Ensure that @owner is only dereferenced after checking
+		 * that it still owns the lock; rcu_read_lock() then keeps
+		 * the task struct around.
+		 */
+		barrier();
+		/*
+		 * Stop spinning when the owner got scheduled out, when we
+		 * need to reschedule or when a higher priority waiter
+		 * queued up in front of us.
+		 */
+		if (!owner->on_cpu || need_resched() ||
+		    READ_ONCE(lock->waiters_leftmost) != &waiter->tree_entry) {
+			ret = false;
+			break;
+		}
+		/*
+		 * Go back to the wait loop, which handles signals and
+		 * timeouts, and sleep if the owner takes too long.
+		 */
+		if (signal_pending_state(state, current) ||
+		    (timeout && !timeout->task) ||
+		    local_clock() > deadline) {
+			ret = false;
+			break;
+		}
+		cpu_relax_lowlatency();
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+#else
+static bool rt_mutex_spin_on_owner(struct rt_mutex *lock,
+				   struct rt_mutex_waiter *waiter,
+				   struct task_struct *owner, int state,
+				   struct hrtimer_sleeper *timeout)
+{
+	return false;
+}
+#endif
+
 /**
  * __rt_mutex_slowlock() - Perform the wait-wake-try-to-take loop
  * @lock:		 the rt_mutex to take
@@ -1172,6 +1243,7 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		    struct hrtimer_sleeper *timeout,
 		    struct rt_mutex_waiter *waiter)
 {
+	struct task_struct *owner;
 	int ret = 0;
 
 	for (;;) {
@@ -1193,11 +1265,19 @@ __rt_mutex_slowlock(struct rt_mutex *lock, int state,
 				break;
 		}
 
+		/* Only the top waiter can take the lock, so only it spins. */
+		if (waiter == rt_mutex_top_waiter(lock))
+			owner = rt_mutex_owner(lock);
+		else
+			owner = NULL;
+
 		raw_spin_unlock(&lock->wait_lock);
 
 		debug_rt_mutex_print_deadlock(waiter);
 
-		schedule();
+		if (!owner ||
+		    !rt_mutex_spin_on_owner(lock, waiter, owner, state, timeout))
+			schedule();
 
 		raw_spin_lock(&lock->wait_lock);
 		set_current_state(state);
@@ -1236,17 +1316,20 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		  enum rtmutex_chainwalk chwalk)
 {
 	struct rt_mutex_waiter waiter;
+	u64 start;
 	int ret = 0;
 
 	debug_rt_mutex_init_waiter(&waiter);
 	RB_CLEAR_NODE(&waiter.pi_tree_entry);
 	RB_CLEAR_NODE(&waiter.tree_entry);
 
+	start = lock_contention_begin(lock, LCB_F_RT);
 	raw_spin_lock(&lock->wait_lock);
 
 	/* Try to acquire the lock again: */
 	if (try_to_take_rt_mutex(lock, current, NULL)) {
 		raw_spin_unlock(&lock->wait_lock);
+		lock_contention_end(lock, start, 0);
 		return 0;
 	}
 
@@ -1282,6 +1365,7 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		hrtimer_cancel(&timeout->timer);
 
 	debug_rt_mutex_free_waiter(&waiter);
+	lock_contention_end(lock, start, ret);
 
 	return ret;
 }
@@ -17,6 +17,7 @@
 #include <linux/osq_lock.h>
 
 #include "rwsem.h"
+#include "lock_contention.h"
 
 /*
  * Guide to the rw_semaphore's count field for common values.
@@ -216,6 +217,7 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
 	struct rwsem_waiter waiter;
 	struct task_struct *tsk = current;
+	u64 start = lock_contention_begin(sem, LCB_F_READ);
 
 	/* set up my own style of waitqueue */
 	waiter.task = tsk;
@@ -251,6 +253,7 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 	}
 
 	__set_task_state(tsk, TASK_RUNNING);
+	lock_contention_end(sem, start, 0);
 	return sem;
 }
 EXPORT_SYMBOL(rwsem_down_read_failed);
@@ -439,13 +442,16 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 	long count;
 	bool waiting = true; /* any queued threads before us */
 	struct rwsem_waiter waiter;
+	u64 start = lock_contention_begin(sem, LCB_F_WRITE);
 
 	/* undo write bias from down_write operation, stop active locking */
 	count = rwsem_atomic_update(-RWSEM_ACTIVE_WRITE_BIAS, sem);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem)) {
+		lock_contention_end(sem, start, 0);
 		return sem;
+	}
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
@@ -496,6 +502,7 @@ struct rw_semaphore __sched *rwsem_down_write_failed(struct rw_semaphore *sem)
 
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
+	lock_contention_end(sem, start, 0);
 
 	return sem;
 }
@@ -43,6 +43,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1545,6 +1546,60 @@ static int console_trylock_for_printk(void)
 	return 1;
 }
 
+/*
+ * Printing to a slow serial console from printk() stalls whatever context
+ * happens to call it, for as long as it takes to drain the log buffer.
+ * Unless printk.synchronous is set, printk() only stores the message and
+ * the printk kthread does the console output.
+ */
+static bool __read_mostly printk_sync;
+module_param_named(synchronous, printk_sync, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_kthread;
+/* Set when the printk kthread should flush the log buffer to consoles */
+static bool printk_kthread_need_flush_console;
+/* Number of emergency reports in progress, see printk_emergency_begin() */
+static atomic_t printk_emergency = ATOMIC_INIT(0);
+
+/**
+ * printk_emergency_begin - print synchronously until printk_emergency_end()
+ *
+ * Reports about a stuck system, such as lockup, stall and hung task
+ * reports or sysrq output, must not depend on the printk kthread, which
+ * may be the very thing that cannot run. Between printk_emergency_begin()
+ * and printk_emergency_end() all messages go to the consoles directly.
+ */
+void printk_emergency_begin(void)
+{
+	atomic_inc(&printk_emergency);
+}
+EXPORT_SYMBOL_GPL(printk_emergency_begin);
+
+void printk_emergency_end(void)
+{
+	atomic_dec(&printk_emergency);
+}
+EXPORT_SYMBOL_GPL(printk_emergency_end);
+
+/*
+ * Print synchronously when the printk kthread is not available or when
+ * it may never get to run: on oops and panic, during emergency reports,
+ * and when the system is going down. The kthread can't be woken from
+ * NMI context at all.
+ */
+static inline bool printk_want_sync(void)
+{
+	return printk_sync || !printk_kthread || oops_in_progress ||
+	       in_nmi() || atomic_read(&printk_emergency) ||
+	       system_state != SYSTEM_RUNNING;
+}
+
+static void printk_kthread_wake(void)
+{
+	printk_kthread_need_flush_console = true;
+	wake_up_process(printk_kthread);
+}
+
 int printk_delay_msec __read_mostly;
 
 static inline void printk_delay(void)
@@ -1816,8 +1871,15 @@ asmlinkage int vprintk_emit(int facility, int level,
 	lockdep_on();
 	local_irq_restore(flags);
 
-	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	/*
+	 * If called from the scheduler, we can not call up(). Emergency and
+	 * alert messages are printed right away, like everything else while
+	 * the printk kthread may not get to run.
+	 */
+	if (!in_sched && level > LOGLEVEL_ALERT && !printk_want_sync()) {
+		/* Leave the console output to the printk kthread */
+		printk_kthread_wake();
+	} else if (!in_sched) {
 		lockdep_off();
 		/*
 		 * Disable preemption to avoid being preempted while holding
@@ -2725,13 +2787,59 @@ late_initcall(printk_late_init);
 
 static DEFINE_PER_CPU(int, printk_pending);
 
+static int printk_kthread_func(void *data)
+{
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!printk_kthread_need_flush_console)
+			schedule();
+
+		__set_current_state(TASK_RUNNING);
+		/*
+		 * Clear the flag before printing, so a printk() racing with
+		 * console_unlock() below makes us go around once more.
+		 * Don't loop when console_unlock() cannot reach the consoles,
+		 * e.g. because they are suspended: resume_console() flushes
+		 * the pending messages.
+		 */
+		printk_kthread_need_flush_console = false;
+		smp_mb();
+
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init init_printk_kthread(void)
+{
+	struct task_struct *task;
+
+	if (printk_sync)
+		return 0;
+
+	task = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(task)) {
+		pr_err("printk: Cannot create printk thread: %ld\n",
+		       PTR_ERR(task));
+		return PTR_ERR(task);
+	}
+
+	printk_kthread = task;
+	return 0;
+}
+late_initcall(init_printk_kthread);
+
 static void wake_up_klogd_work_func(struct irq_work *irq_work)
 {
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+		if (!printk_want_sync())
+			printk_kthread_wake();
 		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
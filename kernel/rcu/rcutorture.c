@@ -62,6 +62,8 @@ torture_param(int, cbflood_intra_holdoff, 1,
 torture_param(int, cbflood_n_burst, 3, "# bursts in flood, zero to disable");
 torture_param(int, cbflood_n_per_burst, 20000,
 	      "# callbacks per burst in flood");
+torture_param(int, cbflood_n_kfree, 1000,
+	      "# kfree_rcu() objects per burst in flood");
 torture_param(int, fqs_duration, 0,
 	      "Duration of fqs bursts (us), 0 to disable");
 torture_param(int, fqs_holdoff, 0, "Holdoff time within fqs bursts (us)");
@@ -149,6 +151,8 @@ static long n_rcu_torture_timers;
 static long n_barrier_attempts;
 static long n_barrier_successes;
 static atomic_long_t n_cbfloods;
+static atomic_long_t n_kfree_rcu;
+static atomic_long_t n_kfree_rcu_alloc_fail;
 static struct list_head rcu_torture_removed;
 
 static int rcu_torture_writer_state;
@@ -810,6 +814,36 @@ static void rcu_torture_cbflood_cb(struct rcu_head *rhp)
 {
 }
 
+/*
+ * Objects handed to kfree_rcu() during callback floods.  They come from
+ * a dedicated cache so that kmem_cache_destroy() at the end of the test
+ * complains if rcu_barrier() failed to wait for batched kfree_rcu().
+ */
+struct rcu_torture_kfree {
+	struct rcu_head rtk_rcu;
+	unsigned long rtk_data[4];
+};
+
+static struct kmem_cache *rcu_torture_kfree_cache;
+
+static void rcu_torture_kfree_burst(void)
+{
+	struct rcu_torture_kfree *rtkp;
+	int i;
+
+	if (!rcu_torture_kfree_cache)
+		return;
+	for (i = 0; i < cbflood_n_kfree; i++) {
+		rtkp = kmem_cache_alloc(rcu_torture_kfree_cache, GFP_KERNEL);
+		if (!rtkp) {
+			atomic_long_inc(&n_kfree_rcu_alloc_fail);
+			return;
+		}
+		kfree_rcu(rtkp, rtk_rcu);
+		atomic_long_inc(&n_kfree_rcu);
+	}
+}
+
 /*
  * RCU torture callback-flood kthread.  Repeatedly induces bursts of calls
  * to call_rcu() or analogous, increasing the probability of occurrence
@@ -846,6 +880,7 @@ rcu_torture_cbflood(void *arg)
 				cur_ops->call(&rhp[i * cbflood_n_per_burst + j],
 					      rcu_torture_cbflood_cb);
 			}
+			rcu_torture_kfree_burst();
 			schedule_timeout_interruptible(cbflood_intra_holdoff);
 			WARN_ON(signal_pending(current));
 		}
@@ -1266,7 +1301,10 @@ rcu_torture_stats_print(void)
 		n_barrier_successes,
 		n_barrier_attempts,
 		n_rcu_torture_barrier_error);
-	pr_cont("cbflood: %ld\n", atomic_long_read(&n_cbfloods));
+	pr_cont("cbflood: %ld ", atomic_long_read(&n_cbfloods));
+	pr_cont("kfree: %ld/%ld\n",
+		atomic_long_read(&n_kfree_rcu),
+		atomic_long_read(&n_kfree_rcu_alloc_fail));
 
 	pr_alert("%s%s ", torture_type, TORTURE_FLAG);
 	if (atomic_read(&n_rcu_torture_mberror) != 0 ||
@@ -1648,6 +1686,10 @@ rcu_torture_cleanup(void)
 		cur_ops->cb_barrier();
 	if (cur_ops->cleanup != NULL)
 		cur_ops->cleanup();
+	if (rcu_torture_kfree_cache) {
+		kmem_cache_destroy(rcu_torture_kfree_cache);
+		rcu_torture_kfree_cache = NULL;
+	}
 
 	rcu_torture_stats_print();  /* -After- the stats thread is stopped! */
 
@@ -1890,6 +1932,10 @@ rcu_torture_init(void)
 	if (object_debug)
 		rcu_test_debug_objects();
 	if (cbflood_n_burst > 0) {
+		/* kfree_rcu() is only exercised against its own flavor. */
+		if (cbflood_n_kfree > 0 && cur_ops == &rcu_ops)
+			rcu_torture_kfree_cache =
+				KMEM_CACHE(rcu_torture_kfree, 0);
 		/* Create the cbflood threads */
 		ncbflooders = (num_online_cpus() + 3) / 4;
 		cbflood_task = kcalloc(ncbflooders, sizeof(*cbflood_task),
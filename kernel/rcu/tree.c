@@ -56,6 +56,9 @@
 #include <linux/random.h>
 #include <linux/trace_events.h>
 #include <linux/suspend.h>
+#include <linux/gfp.h>
+#include <linux/workqueue.h>
+#include <linux/tick.h>
 
 #include "tree.h"
 #include "rcu.h"
@@ -405,6 +408,18 @@ module_param(jiffies_till_next_fqs, ulong, 0644);
 static ulong jiffies_till_sched_qs = HZ / 20;
 module_param(jiffies_till_sched_qs, ulong, 0644);
 
+/*
+ * kfree_rcu() batching: gather objects per CPU and free them in bulk
+ * from a workqueue once a grace period has elapsed for the whole batch,
+ * rather than invoking one callback per object from softirq context.
+ */
+static bool kfree_batch = true;
+module_param(kfree_batch, bool, 0444);
+
+/* Maximum delay before a batch of kfree_rcu() objects is handed to RCU. */
+static ulong jiffies_till_kfree_drain = HZ / 50;
+module_param(jiffies_till_kfree_drain, ulong, 0644);
+
 static bool rcu_start_gp_advanced(struct rcu_state *rsp, struct rcu_node *rnp,
 				  struct rcu_data *rdp);
 static void force_qs_rnp(struct rcu_state *rsp,
@@ -1401,13 +1416,17 @@ static void check_cpu_stall(struct rcu_state *rsp, struct rcu_data *rdp)
 	    (READ_ONCE(rnp->qsmask) & rdp->grpmask)) {
 
 		/* We haven't checked in, so go dump stack. */
+		printk_emergency_begin();
 		print_cpu_stall(rsp);
+		printk_emergency_end();
 
 	} else if (rcu_gp_in_progress(rsp) &&
 		   ULONG_CMP_GE(j, js + RCU_STALL_RAT_DELAY)) {
 
 		/* They had a few time units to dump stack, so complain. */
+		printk_emergency_begin();
 		print_other_cpu_stall(rsp, gpnum);
+		printk_emergency_end();
 	}
 }
 
@@ -3143,6 +3162,181 @@ void call_rcu_bh(struct rcu_head *head, rcu_callback_t func)
 }
 EXPORT_SYMBOL_GPL(call_rcu_bh);
 
+/*
+ * A page worth of pointers to objects passed to kfree_rcu().  Freeing
+ * them from an array touches only the objects themselves, not a linked
+ * list threaded through them, and lets the whole page be retired with a
+ * single grace period.
+ */
+struct kfree_rcu_bulk_data {
+	unsigned long nr_records;
+	struct kfree_rcu_bulk_data *next;
+	void *records[];
+};
+
+#define KFREE_BULK_MAX_ENTR \
+	((PAGE_SIZE - sizeof(struct kfree_rcu_bulk_data)) / sizeof(void *))
+
+/*
+ * Per-CPU kfree_rcu() batching state.  New objects are added to ->bhead,
+ * or chained through their rcu_head on ->head when no page could be
+ * allocated.  ->monitor_work moves them to ->bhead_free/->head_free and
+ * posts a single RCU callback for the batch, which in turn schedules
+ * ->free_work to free the objects in process context.  Only one batch
+ * per CPU waits for a grace period at any given time.
+ */
+struct kfree_rcu_cpu {
+	struct rcu_head rcu;
+	struct work_struct free_work;
+	struct delayed_work monitor_work;
+	struct rcu_head *head;
+	struct kfree_rcu_bulk_data *bhead;
+	struct rcu_head *head_free;
+	struct kfree_rcu_bulk_data *bhead_free;
+	struct kfree_rcu_bulk_data *bcached;	/* Spare page. */
+	spinlock_t lock;
+	bool monitor_todo;
+};
+
+static DEFINE_PER_CPU(struct kfree_rcu_cpu, krc);
+static bool kfree_rcu_batch_ready __read_mostly;
+
+/*
+ * Free a batch of kfree_rcu() objects whose grace period has ended.
+ */
+static void kfree_rcu_work(struct work_struct *work)
+{
+	unsigned long flags;
+	struct rcu_head *head, *next;
+	struct kfree_rcu_bulk_data *bhead, *bnext;
+	struct kfree_rcu_cpu *krcp;
+	unsigned long i;
+
+	krcp = container_of(work, struct kfree_rcu_cpu, free_work);
+	spin_lock_irqsave(&krcp->lock, flags);
+	head = krcp->head_free;
+	krcp->head_free = NULL;
+	bhead = krcp->bhead_free;
+	krcp->bhead_free = NULL;
+	spin_unlock_irqrestore(&krcp->lock, flags);
+
+	for (; bhead; bhead = bnext) {
+		bnext = bhead->next;
+
+		rcu_lock_acquire(&rcu_callback_map);
+		for (i = 0; i < bhead->nr_records; i++)
+			kfree(bhead->records[i]);
+		rcu_lock_release(&rcu_callback_map);
+
+		/* Keep one page around for the next batch. */
+		spin_lock_irqsave(&krcp->lock, flags);
+		if (!krcp->bcached) {
+			krcp->bcached = bhead;
+			bhead = NULL;
+		}
+		spin_unlock_irqrestore(&krcp->lock, flags);
+		if (bhead)
+			free_page((unsigned long)bhead);
+		cond_resched();
+	}
+
+	for (; head; head = next) {
+		next = head->next;
+		__rcu_reclaim(rcu_state_p->name, head);
+		cond_resched();
+	}
+}
+
+/*
+ * RCU callback for a whole batch: the objects cannot be freed from
+ * softirq context without reintroducing the long callback runs that the
+ * batching is meant to avoid, so hand them to a workqueue.
+ */
+static void kfree_rcu_batch_cb(struct rcu_head *rhp)
+{
+	struct kfree_rcu_cpu *krcp = container_of(rhp, struct kfree_rcu_cpu,
+						  rcu);
+
+	schedule_work(&krcp->free_work);
+}
+
+/*
+ * CPU to run the monitor of the current CPU's batch on: full dynticks
+ * CPUs leave it to a housekeeping CPU rather than arm a timer for it.
+ * The batch itself is freed from the RCU callback, which for those CPUs
+ * runs in an rcuo kthread bound to the housekeeping CPUs.
+ * Called with interrupts disabled.
+ */
+static int kfree_rcu_monitor_cpu(void)
+{
+	int cpu = smp_processor_id();
+
+	return is_housekeeping_cpu(cpu) ? cpu : housekeeping_any_cpu();
+}
+
+/*
+ * Hand the objects queued on this CPU to RCU, unless the previous batch
+ * is still in flight, in which case try again later.  Called with
+ * krcp->lock held, releases it.
+ */
+static void kfree_rcu_drain_unlock(struct kfree_rcu_cpu *krcp,
+				   unsigned long flags)
+{
+	if (krcp->head_free || krcp->bhead_free) {
+		queue_delayed_work_on(kfree_rcu_monitor_cpu(), system_wq,
+				      &krcp->monitor_work,
+				      jiffies_till_kfree_drain);
+		spin_unlock_irqrestore(&krcp->lock, flags);
+		return;
+	}
+
+	krcp->head_free = krcp->head;
+	krcp->head = NULL;
+	krcp->bhead_free = krcp->bhead;
+	krcp->bhead = NULL;
+	krcp->monitor_todo = false;
+	spin_unlock_irqrestore(&krcp->lock, flags);
+
+	call_rcu(&krcp->rcu, kfree_rcu_batch_cb);
+}
+
+static void kfree_rcu_monitor(struct work_struct *work)
+{
+	unsigned long flags;
+	struct kfree_rcu_cpu *krcp = container_of(work, struct kfree_rcu_cpu,
+						  monitor_work.work);
+
+	spin_lock_irqsave(&krcp->lock, flags);
+	if (krcp->monitor_todo)
+		kfree_rcu_drain_unlock(krcp, flags);
+	else
+		spin_unlock_irqrestore(&krcp->lock, flags);
+}
+
+/*
+ * Record ptr in the current page of krcp, allocating a new page if the
+ * current one is full.  Return false if no page is available.
+ */
+static bool kfree_rcu_bulk_add(struct kfree_rcu_cpu *krcp, void *ptr)
+{
+	struct kfree_rcu_bulk_data *bnode = krcp->bhead;
+
+	if (!bnode || bnode->nr_records == KFREE_BULK_MAX_ENTR) {
+		bnode = krcp->bcached;
+		krcp->bcached = NULL;
+		if (!bnode)
+			bnode = (struct kfree_rcu_bulk_data *)
+				__get_free_page(GFP_NOWAIT | __GFP_NOWARN);
+		if (!bnode)
+			return false;
+		bnode->nr_records = 0;
+		bnode->next = krcp->bhead;
+		krcp->bhead = bnode;
+	}
+	bnode->records[bnode->nr_records++] = ptr;
+	return true;
+}
+
 /*
  * Queue an RCU callback for lazy invocation after a grace period.
  * This will likely be later named something like "call_rcu_lazy()",
@@ -3153,10 +3347,54 @@ EXPORT_SYMBOL_GPL(call_rcu_bh);
 void kfree_call_rcu(struct rcu_head *head,
 		    rcu_callback_t func)
 {
-	__call_rcu(head, func, rcu_state_p, -1, 1);
+	unsigned long flags;
+	struct kfree_rcu_cpu *krcp;
+
+	/* Early boot or batching disabled: one callback per object. */
+	if (!READ_ONCE(kfree_rcu_batch_ready)) {
+		__call_rcu(head, func, rcu_state_p, -1, 1);
+		return;
+	}
+
+	local_irq_save(flags);
+	krcp = this_cpu_ptr(&krc);
+	spin_lock(&krcp->lock);
+
+	if (!kfree_rcu_bulk_add(krcp, (void *)head - (unsigned long)func)) {
+		head->func = func;
+		head->next = krcp->head;
+		krcp->head = head;
+	}
+
+	if (!krcp->monitor_todo) {
+		krcp->monitor_todo = true;
+		queue_delayed_work_on(kfree_rcu_monitor_cpu(), system_wq,
+				      &krcp->monitor_work,
+				      jiffies_till_kfree_drain);
+	}
+	spin_unlock_irqrestore(&krcp->lock, flags);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
+static int __init kfree_rcu_batch_init(void)
+{
+	int cpu;
+
+	if (!kfree_batch)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct kfree_rcu_cpu *krcp = per_cpu_ptr(&krc, cpu);
+
+		spin_lock_init(&krcp->lock);
+		INIT_WORK(&krcp->free_work, kfree_rcu_work);
+		INIT_DELAYED_WORK(&krcp->monitor_work, kfree_rcu_monitor);
+	}
+	WRITE_ONCE(kfree_rcu_batch_ready, true);
+	return 0;
+}
+core_initcall(kfree_rcu_batch_init);
+
 /*
  * Because a context switch is a grace period for RCU-sched and RCU-bh,
  * any blocking grace-period wait automatically implies a grace period
@@ -4121,6 +4359,36 @@ static void _rcu_barrier(struct rcu_state *rsp)
 	mutex_unlock(&rsp->barrier_mutex);
 }
 
+/*
+ * Like _rcu_barrier(), but for the flavor backing kfree_rcu() also wait
+ * for the objects batched by kfree_call_rcu() to be freed, as callers
+ * such as kmem_cache_destroy() users rely on that.  Two rounds are
+ * needed: the first retires a batch that may already be waiting for its
+ * grace period, the second the objects that were queued behind it.
+ */
+static void _rcu_barrier_kfree(struct rcu_state *rsp)
+{
+	struct kfree_rcu_cpu *krcp;
+	int cpu;
+	int i;
+
+	if (rsp != rcu_state_p || !READ_ONCE(kfree_rcu_batch_ready)) {
+		_rcu_barrier(rsp);
+		return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		for_each_possible_cpu(cpu) {
+			krcp = per_cpu_ptr(&krc, cpu);
+			mod_delayed_work(system_wq, &krcp->monitor_work, 0);
+			flush_delayed_work(&krcp->monitor_work);
+		}
+		_rcu_barrier(rsp);
+		for_each_possible_cpu(cpu)
+			flush_work(&per_cpu_ptr(&krc, cpu)->free_work);
+	}
+}
+
 /**
  * rcu_barrier_bh - Wait until all in-flight call_rcu_bh() callbacks complete.
  */
@@ -4135,7 +4403,7 @@ EXPORT_SYMBOL_GPL(rcu_barrier_bh);
  */
 void rcu_barrier_sched(void)
 {
-	_rcu_barrier(&rcu_sched_state);
+	_rcu_barrier_kfree(&rcu_sched_state);
 }
 EXPORT_SYMBOL_GPL(rcu_barrier_sched);
 
@@ -779,7 +779,7 @@ EXPORT_SYMBOL_GPL(synchronize_rcu_expedited);
  */
 void rcu_barrier(void)
 {
-	_rcu_barrier(rcu_state_p);
+	_rcu_barrier_kfree(rcu_state_p);
 }
 EXPORT_SYMBOL_GPL(rcu_barrier);
 
@@ -2238,6 +2238,9 @@ static int rcu_nocb_kthread(void *arg)
 	struct rcu_head **tail;
 	struct rcu_data *rdp = arg;
 
+	/* Invoke callbacks on housekeeping CPUs.  Sysadm can move if desired. */
+	housekeeping_affine(current);
+
 	/* Each pass through this loop invokes one batch of callbacks */
 	for (;;) {
 		/* Wait for callbacks. */
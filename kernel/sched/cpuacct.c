@@ -31,6 +31,10 @@ struct cpuacct {
 	/* cpuusage holds pointer to a u64-type object on every cpu */
 	u64 __percpu *cpuusage;
 	struct kernel_cpustat __percpu *cpustat;
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* wakeup-to-run latency of the tasks in this group and below */
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
 };
 
 static inline struct cpuacct *css_ca(struct cgroup_subsys_state *css)
@@ -50,9 +54,15 @@ static inline struct cpuacct *parent_ca(struct cpuacct *ca)
 }
 
 static DEFINE_PER_CPU(u64, root_cpuacct_cpuusage);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static DEFINE_PER_CPU(struct sched_lat_hist, root_cpuacct_lat_hist);
+#endif
 static struct cpuacct root_cpuacct = {
 	.cpustat	= &kernel_cpustat,
 	.cpuusage	= &root_cpuacct_cpuusage,
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	.lat_hist	= &root_cpuacct_lat_hist,
+#endif
 };
 
 /* create a new cpu accounting group */
@@ -76,8 +86,18 @@ cpuacct_css_alloc(struct cgroup_subsys_state *parent_css)
 	if (!ca->cpustat)
 		goto out_free_cpuusage;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	ca->lat_hist = alloc_percpu(struct sched_lat_hist);
+	if (!ca->lat_hist)
+		goto out_free_cpustat;
+#endif
+
 	return &ca->css;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+out_free_cpustat:
+	free_percpu(ca->cpustat);
+#endif
 out_free_cpuusage:
 	free_percpu(ca->cpuusage);
 out_free_ca:
@@ -91,6 +111,9 @@ static void cpuacct_css_free(struct cgroup_subsys_state *css)
 {
 	struct cpuacct *ca = css_ca(css);
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	free_percpu(ca->lat_hist);
+#endif
 	free_percpu(ca->cpustat);
 	free_percpu(ca->cpuusage);
 	kfree(ca);
@@ -210,6 +233,25 @@ static int cpuacct_stats_show(struct seq_file *sf, void *v)
 	return 0;
 }
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static int cpuacct_lat_hist_show(struct seq_file *sf, void *v)
+{
+	struct cpuacct *ca = css_ca(seq_css(sf));
+	int i, cpu;
+
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++) {
+		u64 count = 0;
+
+		for_each_possible_cpu(cpu)
+			count += per_cpu_ptr(ca->lat_hist, cpu)->count[i];
+		seq_printf(sf, "%llu %llu\n", sched_lat_hist_bucket_ns(i),
+			   count);
+	}
+
+	return 0;
+}
+#endif
+
 static struct cftype files[] = {
 	{
 		.name = "usage",
@@ -224,6 +266,12 @@ static struct cftype files[] = {
 		.name = "stat",
 		.seq_show = cpuacct_stats_show,
 	},
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	{
+		.name = "wakeup_latency",
+		.seq_show = cpuacct_lat_hist_show,
+	},
+#endif
 	{ }	/* terminate */
 };
 
@@ -275,6 +323,27 @@ void cpuacct_account_field(struct task_struct *p, int index, u64 val)
 	rcu_read_unlock();
 }
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Account a wakeup-to-run latency sample of this task to its accounting
+ * group and all of its ancestors.
+ *
+ * called with rq->lock held.
+ */
+void cpuacct_lat_hist_account(struct task_struct *tsk, unsigned int bucket)
+{
+	struct cpuacct *ca;
+	int cpu;
+
+	cpu = task_cpu(tsk);
+
+	rcu_read_lock();
+	for (ca = task_ca(tsk); ca; ca = parent_ca(ca))
+		per_cpu_ptr(ca->lat_hist, cpu)->count[bucket]++;
+	rcu_read_unlock();
+}
+#endif
+
 struct cgroup_subsys cpuacct_cgrp_subsys = {
 	.css_alloc	= cpuacct_css_alloc,
 	.css_free	= cpuacct_css_free,
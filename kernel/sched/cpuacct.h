@@ -15,3 +15,13 @@ cpuacct_account_field(struct task_struct *p, int index, u64 val)
 }
 
 #endif
+
+#if defined(CONFIG_CGROUP_CPUACCT) && defined(CONFIG_SCHED_LATENCY_HIST)
+extern void cpuacct_lat_hist_account(struct task_struct *tsk,
+				     unsigned int bucket);
+#else
+static inline void
+cpuacct_lat_hist_account(struct task_struct *tsk, unsigned int bucket)
+{
+}
+#endif
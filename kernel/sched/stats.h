@@ -47,6 +47,52 @@ rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 # define schedstat_set(var, val)	do { } while (0)
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+DECLARE_STATIC_KEY_FALSE(sched_lat_hist_enabled);
+
+/*
+ * A wakeup starts a latency sample. If the task is migrated before it
+ * gets to run, the delay accrued on the old runqueue is carried over so
+ * that the sample covers the whole wakeup-to-run interval.
+ */
+static inline void sched_lat_hist_queued(struct task_struct *t, int wakeup)
+{
+	if (static_branch_unlikely(&sched_lat_hist_enabled) && wakeup) {
+		t->sched_info.in_wakeup = 1;
+		t->sched_info.wakeup_delay = 0;
+	}
+}
+
+static inline void
+sched_lat_hist_dequeued(struct task_struct *t, unsigned long long delta)
+{
+	if (unlikely(t->sched_info.in_wakeup))
+		t->sched_info.wakeup_delay += delta;
+}
+
+static inline void
+sched_lat_hist_arrive(struct task_struct *t, unsigned long long delta)
+{
+	unsigned int bucket;
+
+	if (likely(!t->sched_info.in_wakeup))
+		return;
+
+	t->sched_info.in_wakeup = 0;
+	delta += t->sched_info.wakeup_delay;
+	bucket = min_t(unsigned int, fls64(delta >> SCHED_LAT_HIST_SHIFT),
+		       SCHED_LAT_HIST_BUCKETS - 1);
+	t->sched_info.lat_hist.count[bucket]++;
+	cpuacct_lat_hist_account(t, bucket);
+}
+#else
+static inline void sched_lat_hist_queued(struct task_struct *t, int wakeup) { }
+static inline void
+sched_lat_hist_dequeued(struct task_struct *t, unsigned long long delta) { }
+static inline void
+sched_lat_hist_arrive(struct task_struct *t, unsigned long long delta) { }
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 #ifdef CONFIG_SCHED_INFO
 static inline void sched_info_reset_dequeued(struct task_struct *t)
 {
@@ -68,6 +114,7 @@ static inline void sched_info_dequeued(struct rq *rq, struct task_struct *t)
 			delta = now - t->sched_info.last_queued;
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
+	sched_lat_hist_dequeued(t, delta);
 
 	rq_sched_info_dequeued(rq, delta);
 }
@@ -87,6 +134,7 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
+	sched_lat_hist_arrive(t, delta);
 
 	rq_sched_info_arrive(rq, delta);
 }
@@ -94,13 +142,17 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 /*
  * This function is only called from enqueue_task(), but also only updates
  * the timestamp if it is already not set.  It's assumed that
- * sched_info_dequeued() will clear that stamp when appropriate.
+ * sched_info_dequeued() will clear that stamp when appropriate. @wakeup
+ * tells whether the task is being queued because it was woken up.
  */
-static inline void sched_info_queued(struct rq *rq, struct task_struct *t)
+static inline void
+sched_info_queued(struct rq *rq, struct task_struct *t, int wakeup)
 {
 	if (unlikely(sched_info_on()))
-		if (!t->sched_info.last_queued)
+		if (!t->sched_info.last_queued) {
 			t->sched_info.last_queued = rq_clock(rq);
+			sched_lat_hist_queued(t, wakeup);
+		}
 }
 
 /*
@@ -119,7 +171,7 @@ static inline void sched_info_depart(struct rq *rq, struct task_struct *t)
 	rq_sched_info_depart(rq, delta);
 
 	if (t->state == TASK_RUNNING)
-		sched_info_queued(rq, t);
+		sched_info_queued(rq, t, 0);
 }
 
 /*
@@ -150,7 +202,7 @@ sched_info_switch(struct rq *rq,
 		__sched_info_switch(rq, prev, next);
 }
 #else
-#define sched_info_queued(rq, t)		do { } while (0)
+#define sched_info_queued(rq, t, wakeup)	do { } while (0)
 #define sched_info_reset_dequeued(t)	do { } while (0)
 #define sched_info_dequeued(rq, t)		do { } while (0)
 #define sched_info_depart(rq, t)		do { } while (0)
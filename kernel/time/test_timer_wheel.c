@@ -0,0 +1,242 @@
+/*
+ * Timer wheel benchmark kernel module
+ *
+ * Test is executed by writing and reading to /sys/kernel/debug/timer_wheel_test
+ * The number of timers is configured by writing: TIMERS
+ * The benchmark is executed by reading from the same file.
+ *
+ * It measures the average cost of arming, re-arming and cancelling a large
+ * number of timers with random expiry times, which is the common pattern of
+ * networking timeouts, and the time the timer softirq takes to run a batch
+ * of timers which are all due in the same jiffy, from the first callback
+ * to the last one.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/timer.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#define DEFAULT_TIMERS		(1 << 20)
+
+/* Random expiry times are spread over this many jiffies */
+#define RANDOM_RANGE		(60 * HZ)
+
+/* Timers in the expiry run are all due this many jiffies after arming */
+#define EXPIRY_DELAY		HZ
+
+#define DEBUGFS_FILENAME "timer_wheel_test"
+
+static DEFINE_MUTEX(timer_wheel_test_lock);
+static struct dentry *timer_wheel_test_debugfs_file;
+static int timer_wheel_test_timers = DEFAULT_TIMERS;
+
+static int timer_wheel_test_nr;
+static atomic_t timer_wheel_test_pending;
+static ktime_t timer_wheel_test_first, timer_wheel_test_last;
+static DECLARE_COMPLETION(timer_wheel_test_done);
+
+static void timer_wheel_test_fn(unsigned long data)
+{
+	int left = atomic_dec_return(&timer_wheel_test_pending);
+
+	if (left == timer_wheel_test_nr - 1)
+		timer_wheel_test_first = ktime_get();
+	if (!left) {
+		timer_wheel_test_last = ktime_get();
+		complete(&timer_wheel_test_done);
+	}
+}
+
+static void timer_wheel_test_nop(unsigned long data)
+{
+}
+
+static unsigned long timer_wheel_test_random(void)
+{
+	return jiffies + 1 + prandom_u32_max(RANDOM_RANGE);
+}
+
+static void timer_wheel_test_print(struct seq_file *s, const char *what,
+				   u64 ns, int nr)
+{
+	u64 avg = ns;
+
+	do_div(avg, nr);
+	seq_printf(s, "%-10s %d timers: total=%llu ns avg=%llu ns\n",
+		   what, nr, ns, avg);
+}
+
+static void timer_wheel_test_report(struct seq_file *s, const char *what,
+				    ktime_t start, int nr)
+{
+	ktime_t delta = ktime_sub(ktime_get(), start);
+
+	timer_wheel_test_print(s, what, ktime_to_ns(delta), nr);
+}
+
+static int timer_wheel_test_run(struct seq_file *s, int nr)
+{
+	struct timer_list *timers;
+	unsigned long left, expires;
+	ktime_t start;
+	int i;
+
+	timers = vmalloc(nr * sizeof(*timers));
+	if (!timers)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++)
+		setup_timer(&timers[i], timer_wheel_test_nop, i);
+
+	start = ktime_get();
+	for (i = 0; i < nr; i++)
+		mod_timer(&timers[i], timer_wheel_test_random());
+	timer_wheel_test_report(s, "add", start, nr);
+
+	start = ktime_get();
+	for (i = 0; i < nr; i++)
+		mod_timer(&timers[i], timer_wheel_test_random());
+	timer_wheel_test_report(s, "mod", start, nr);
+
+	start = ktime_get();
+	for (i = 0; i < nr; i++)
+		del_timer(&timers[i]);
+	timer_wheel_test_report(s, "del", start, nr);
+
+	for (i = 0; i < nr; i++)
+		timers[i].function = timer_wheel_test_fn;
+
+	reinit_completion(&timer_wheel_test_done);
+	timer_wheel_test_nr = nr;
+	atomic_set(&timer_wheel_test_pending, nr);
+
+	/*
+	 * Arm everything for the same jiffy, far enough out that arming is
+	 * done before the first timer fires, so that only the expiry itself
+	 * is timed.
+	 */
+	expires = jiffies + EXPIRY_DELAY;
+	for (i = 0; i < nr; i++)
+		mod_timer(&timers[i], expires);
+	if (time_after_eq(jiffies, expires))
+		seq_puts(s, "expire     arming outlasted the expiry delay, "
+			    "result is skewed\n");
+
+	left = wait_for_completion_timeout(&timer_wheel_test_done,
+					   EXPIRY_DELAY + 60 * HZ);
+	if (left) {
+		ktime_t delta = ktime_sub(timer_wheel_test_last,
+					  timer_wheel_test_first);
+
+		timer_wheel_test_print(s, "expire", ktime_to_ns(delta), nr);
+	} else {
+		seq_printf(s, "expire FAIL=%d timers did not expire\n",
+			   atomic_read(&timer_wheel_test_pending));
+	}
+
+	for (i = 0; i < nr; i++)
+		del_timer_sync(&timers[i]);
+	vfree(timers);
+
+	return 0;
+}
+
+static int timer_wheel_test_show(struct seq_file *s, void *v)
+{
+	int timers;
+
+	mutex_lock(&timer_wheel_test_lock);
+	timers = timer_wheel_test_timers;
+
+	if (timers > 0) {
+		int ret = timer_wheel_test_run(s, timers);
+
+		mutex_unlock(&timer_wheel_test_lock);
+		return ret;
+	}
+	mutex_unlock(&timer_wheel_test_lock);
+
+	seq_printf(s, "timer wheel test (HZ=%d)\n", HZ);
+	seq_puts(s, "usage:\n");
+	seq_puts(s, "echo TIMERS > " DEBUGFS_FILENAME "\n");
+	seq_puts(s, "cat " DEBUGFS_FILENAME "\n");
+
+	return 0;
+}
+
+static int timer_wheel_test_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, timer_wheel_test_show, inode->i_private);
+}
+
+static ssize_t timer_wheel_test_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *pos)
+{
+	char lbuf[32];
+	int timers;
+
+	if (count >= sizeof(lbuf))
+		return -EINVAL;
+
+	if (copy_from_user(lbuf, buf, count))
+		return -EFAULT;
+	lbuf[count] = '\0';
+
+	if (sscanf(lbuf, "%d", &timers) < 1)
+		return -EINVAL;
+
+	mutex_lock(&timer_wheel_test_lock);
+	timer_wheel_test_timers = timers;
+	mutex_unlock(&timer_wheel_test_lock);
+
+	return count;
+}
+
+static const struct file_operations timer_wheel_test_debugfs_ops = {
+	.owner = THIS_MODULE,
+	.open = timer_wheel_test_open,
+	.read = seq_read,
+	.write = timer_wheel_test_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init timer_wheel_test_init(void)
+{
+	mutex_lock(&timer_wheel_test_lock);
+	timer_wheel_test_debugfs_file = debugfs_create_file(DEBUGFS_FILENAME,
+			S_IRUSR | S_IWUSR, NULL, NULL,
+			&timer_wheel_test_debugfs_ops);
+	mutex_unlock(&timer_wheel_test_lock);
+
+	return 0;
+}
+
+module_init(timer_wheel_test_init);
+
+static void __exit timer_wheel_test_exit(void)
+{
+	mutex_lock(&timer_wheel_test_lock);
+	debugfs_remove(timer_wheel_test_debugfs_file);
+	mutex_unlock(&timer_wheel_test_lock);
+}
+
+module_exit(timer_wheel_test_exit);
+
+MODULE_LICENSE("GPL");
@@ -24,6 +24,7 @@
 #include <linux/posix-timers.h>
 #include <linux/perf_event.h>
 #include <linux/context_tracking.h>
+#include <linux/workqueue.h>
 
 #include <asm/irq_regs.h>
 
@@ -229,6 +230,7 @@ void tick_nohz_full_kick_cpu(int cpu)
 	if (!tick_nohz_full_cpu(cpu))
 		return;
 
+	trace_isolation_violation(cpu, "kick", (void *)_RET_IP_);
 	irq_work_queue_on(&per_cpu(nohz_full_kick_work, cpu), cpu);
 }
 
@@ -243,10 +245,17 @@ static void nohz_full_kick_ipi(void *info)
  */
 void tick_nohz_full_kick_all(void)
 {
+	int cpu;
+
 	if (!tick_nohz_full_running)
 		return;
 
 	preempt_disable();
+	if (trace_isolation_violation_enabled()) {
+		for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+			trace_isolation_violation(cpu, "kick_all",
+						  (void *)_RET_IP_);
+	}
 	smp_call_function_many(tick_nohz_full_mask,
 			       nohz_full_kick_ipi, NULL, false);
 	tick_nohz_full_kick();
@@ -378,6 +387,25 @@ void __init tick_nohz_init(void)
 	 */
 	WARN_ON_ONCE(cpumask_empty(housekeeping_mask));
 }
+
+/*
+ * Keep unbound workqueue workers off full dynticks CPUs. This can be
+ * overridden through /sys/devices/virtual/workqueue/cpumask.
+ */
+static int __init tick_nohz_full_wq_init(void)
+{
+	int ret;
+
+	if (!tick_nohz_full_running)
+		return 0;
+
+	ret = workqueue_set_unbound_cpumask(housekeeping_mask);
+	if (ret)
+		pr_warn("NO_HZ: Can't restrict unbound workqueues to housekeeping CPUs: %d\n",
+			ret);
+	return 0;
+}
+late_initcall(tick_nohz_full_wq_init);
 #endif
 
 /*
@@ -623,6 +651,11 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 	delta = next_tick - basemono;
 	if (delta <= (u64)TICK_NSEC) {
 		tick.tv64 = 0;
+		/*
+		 * Tell the timer code that the base is not idle, i.e. undo
+		 * the effect of get_next_timer_interrupt():
+		 */
+		timer_clear_idle();
 		if (!ts->tick_stopped)
 			goto out;
 		if (delta == 0) {
@@ -715,6 +748,12 @@ static void tick_nohz_restart_sched_tick(struct tick_sched *ts, ktime_t now)
 	tick_do_update_jiffies64(now);
 	update_cpu_load_nohz();
 
+	/*
+	 * Clear the timer idle flag, so we avoid IPIs on remote queueing and
+	 * the clock forward checks in the enqueue path:
+	 */
+	timer_clear_idle();
+
 	calc_load_exit_idle();
 	touch_softlockup_watchdog();
 	/*
@@ -230,6 +230,7 @@ struct trace_array {
 #endif
 	int			stop_count;
 	int			clock_id;
+	int			buffer_percent;	/* trace_pipe_raw splice wakeup */
 	int			nr_topts;
 	struct tracer		*current_trace;
 	unsigned int		trace_flags;
@@ -1040,11 +1041,14 @@ struct ftrace_event_field {
 	int			is_signed;
 };
 
+struct filter_prog_entry;
+
 struct event_filter {
 	int			n_preds;	/* Number assigned */
 	int			a_preds;	/* allocated */
 	struct filter_pred	*preds;
 	struct filter_pred	*root;
+	struct filter_prog_entry *prog;		/* compiled preds, may be NULL */
 	char			*filter_string;
 };
 
@@ -1176,7 +1180,9 @@ struct event_trigger_data {
  * @func: The trigger 'probe' function called when the triggering
  *	event occurs.  The data passed into this callback is the data
  *	that was supplied to the event_command @reg() function that
- *	registered the trigger (see struct event_command).
+ *	registered the trigger (see struct event_command).  The @rec
+ *	is the event record, or NULL if the trigger is invoked
+ *	unconditionally or after the event was committed.
  *
  * @init: An optional initialization function called for the trigger
  *	when the trigger is registered (via the event_command reg()
@@ -1201,7 +1207,8 @@ struct event_trigger_data {
  *	(see trace_event_triggers.c).
  */
 struct event_trigger_ops {
-	void			(*func)(struct event_trigger_data *data);
+	void			(*func)(struct event_trigger_data *data,
+					void *rec);
 	int			(*init)(struct event_trigger_ops *ops,
 					struct event_trigger_data *data);
 	void			(*free)(struct event_trigger_ops *ops,
@@ -1225,8 +1232,8 @@ struct event_trigger_ops {
  * The data members in this structure provide per-event command data
  * for various event commands.
  *
- * All the data members below, except for @post_trigger, must be set
- * for each event command.
+ * All the data members below, except for @post_trigger and
+ * @needs_rec, must be set for each event command.
  *
  * @name: The unique name that identifies the event command.  This is
  *	the name used when setting triggers via trigger files.
@@ -1264,6 +1271,12 @@ struct event_trigger_ops {
  *	itself logs to the trace buffer, this flag should be set,
  *	otherwise it can be left unspecified.
  *
+ * @needs_rec: A flag that says whether or not this command needs
+ *	the event record to do its job, for instance to read the
+ *	fields of the event.  Triggers of such commands are always
+ *	invoked once the event record has been filled in, and get
+ *	it passed in as @rec.
+ *
  * All the methods below, except for @set_filter(), must be
  * implemented.
  *
@@ -1304,6 +1317,7 @@ struct event_command {
 	char			*name;
 	enum event_trigger_type	trigger_type;
 	bool			post_trigger;
+	bool			needs_rec;
 	int			(*func)(struct event_command *cmd_ops,
 					struct trace_event_file *file,
 					char *glob, char *cmd, char *params);
@@ -1321,6 +1335,27 @@ struct event_command {
 	struct event_trigger_ops *(*get_trigger_ops)(char *cmd, char *param);
 };
 
+extern void trigger_data_free(struct event_trigger_data *data);
+extern int event_trigger_init(struct event_trigger_ops *ops,
+			      struct event_trigger_data *data);
+extern int trace_event_trigger_enable_disable(struct trace_event_file *file,
+					      int trigger_enable);
+extern void update_cond_flag(struct trace_event_file *file);
+extern void unregister_trigger(char *glob, struct event_trigger_ops *ops,
+			       struct event_trigger_data *test,
+			       struct trace_event_file *file);
+extern int set_trigger_filter(char *filter_str,
+			      struct event_trigger_data *trigger_data,
+			      struct trace_event_file *file);
+extern int register_event_command(struct event_command *cmd);
+
+#ifdef CONFIG_HIST_TRIGGERS
+extern int register_trigger_hist_cmd(void);
+extern const struct file_operations event_hist_fops;
+#else
+static inline int register_trigger_hist_cmd(void) { return 0; }
+#endif
+
 extern int trace_event_enable_disable(struct trace_event_file *file,
 				      int enable, int soft_disable);
 extern int tracing_alloc_snapshot(void);
@@ -578,19 +578,48 @@ static int filter_match_preds_cb(enum move_type move, struct filter_pred *pred,
 		 * if ((match && pred->op == OP_OR) ||
 		 *     (!match && pred->op == OP_AND))
 		 */
-		if (!!d->match == (pred->op == OP_OR))
+		if (!!d->match == (pred->op == OP_OR)) {
+			d->match = !!d->match ^ pred->not;
 			return WALK_PRED_PARENT;
+		}
 		break;
 	case MOVE_UP_FROM_RIGHT:
+		/* Done with both sides, apply a '!' on this node */
+		d->match = !!d->match ^ pred->not;
 		break;
 	}
 
 	return WALK_PRED_DEFAULT;
 }
 
+/*
+ * A compiled filter is the leafs of the pred tree laid out in an
+ * array, in the order they are tested. Each entry holds the index
+ * of the entry to test next when its pred does not match or does
+ * match. The AND and OR nodes, and any '!' applied to them, only
+ * exist as those jump targets. The array ends with two entries
+ * without a pred, whose target[0] is the result of the filter.
+ */
+struct filter_prog_entry {
+	struct filter_pred	*pred;
+	unsigned short		target[2];
+};
+
+static int filter_run_prog(struct filter_prog_entry *prog, void *rec)
+{
+	struct filter_prog_entry *ent = prog;
+	struct filter_pred *pred;
+
+	while ((pred = ent->pred))
+		ent = &prog[ent->target[!!pred->fn(pred, rec)]];
+
+	return ent->target[0];
+}
+
 /* return 1 if event matches, 0 otherwise (discard) */
 int filter_match_preds(struct event_filter *filter, void *rec)
 {
+	struct filter_prog_entry *prog;
 	struct filter_pred *preds;
 	struct filter_pred *root;
 	struct filter_match_preds_data data = {
@@ -615,6 +644,10 @@ int filter_match_preds(struct event_filter *filter, void *rec)
 	if (!root)
 		return 1;
 
+	prog = rcu_dereference_sched(filter->prog);
+	if (prog)
+		return filter_run_prog(prog, rec);
+
 	data.preds = preds = rcu_dereference_sched(filter->preds);
 	ret = walk_pred_tree(preds, root, filter_match_preds_cb, &data);
 	WARN_ON(ret);
@@ -817,6 +850,9 @@ static void __free_preds(struct event_filter *filter)
 {
 	int i;
 
+	kfree(filter->prog);
+	filter->prog = NULL;
+
 	if (filter->preds) {
 		for (i = 0; i < filter->n_preds; i++)
 			kfree(filter->preds[i].ops);
@@ -1618,6 +1654,124 @@ static int fold_pred_tree(struct event_filter *filter,
 			      filter->preds);
 }
 
+struct compile_pred_data {
+	struct filter_pred	*preds;
+	struct filter_prog_entry *prog;
+	unsigned short		*leafs;		/* leafs below each pred */
+	unsigned short		*on_true;	/* where each pred jumps to */
+	unsigned short		*on_false;
+	int			next;		/* next prog entry to fill */
+};
+
+static int count_pred_leafs_cb(enum move_type move, struct filter_pred *pred,
+			       int *err, void *data)
+{
+	struct compile_pred_data *d = data;
+	int idx = pred - d->preds;
+
+	if (move == MOVE_DOWN && pred->left == FILTER_PRED_INVALID)
+		d->leafs[idx] = 1;
+	else if (move == MOVE_UP_FROM_RIGHT)
+		d->leafs[idx] = d->leafs[pred->left] + d->leafs[pred->right];
+
+	return WALK_PRED_DEFAULT;
+}
+
+static int compile_pred_cb(enum move_type move, struct filter_pred *pred,
+			   int *err, void *data)
+{
+	struct compile_pred_data *d = data;
+	int idx = pred - d->preds;
+	unsigned short t, f, right;
+
+	if (move != MOVE_DOWN)
+		return WALK_PRED_DEFAULT;
+
+	t = d->on_true[idx];
+	f = d->on_false[idx];
+
+	/* Leafs handle their own '!' in pred->fn() */
+	if (pred->left == FILTER_PRED_INVALID) {
+		d->prog[d->next].pred = pred;
+		d->prog[d->next].target[1] = t;
+		d->prog[d->next].target[0] = f;
+		d->next++;
+		return WALK_PRED_DEFAULT;
+	}
+
+	if (pred->not)
+		swap(t, f);
+
+	/* The right side starts after all the leafs on the left side */
+	right = d->next + d->leafs[pred->left];
+
+	if (pred->op == OP_AND) {
+		d->on_true[pred->left] = right;
+		d->on_false[pred->left] = f;
+	} else {
+		d->on_true[pred->left] = t;
+		d->on_false[pred->left] = right;
+	}
+	d->on_true[pred->right] = t;
+	d->on_false[pred->right] = f;
+
+	return WALK_PRED_DEFAULT;
+}
+
+/*
+ * Walking the pred tree for every event costs a callback per node
+ * and a climb back up the tree for every short circuit. Flatten it
+ * into a filter_prog_entry array instead, so matching an event is a
+ * loop over the leafs that jumps straight to the next leaf to test.
+ * If the array can not be allocated, the tree walk is still used.
+ */
+static int compile_pred_tree(struct event_filter *filter,
+			     struct filter_pred *root)
+{
+	struct compile_pred_data data = {
+		.preds = filter->preds,
+	};
+	int n = filter->n_preds;
+	int n_leafs;
+	int err;
+
+	data.leafs = kcalloc(n * 3, sizeof(*data.leafs), GFP_KERNEL);
+	if (!data.leafs)
+		return -ENOMEM;
+	data.on_true = data.leafs + n;
+	data.on_false = data.on_true + n;
+
+	err = walk_pred_tree(filter->preds, root, count_pred_leafs_cb, &data);
+	if (err)
+		goto out;
+
+	n_leafs = data.leafs[root - filter->preds];
+	data.prog = kcalloc(n_leafs + 2, sizeof(*data.prog), GFP_KERNEL);
+	if (!data.prog) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	/* The two entries after the leafs hold the result */
+	data.prog[n_leafs].target[0] = 1;
+	data.prog[n_leafs + 1].target[0] = 0;
+	data.on_true[root - filter->preds] = n_leafs;
+	data.on_false[root - filter->preds] = n_leafs + 1;
+
+	err = walk_pred_tree(filter->preds, root, compile_pred_cb, &data);
+	if (WARN_ON(!err && data.next != n_leafs))
+		err = -EINVAL;
+	if (err) {
+		kfree(data.prog);
+		goto out;
+	}
+
+	filter->prog = data.prog;
+ out:
+	kfree(data.leafs);
+	return err;
+}
+
 static int replace_preds(struct trace_event_call *call,
 			 struct event_filter *filter,
 			 struct filter_parse_state *ps,
@@ -1720,6 +1874,9 @@ static int replace_preds(struct trace_event_call *call,
 		if (err)
 			goto fail;
 
+		/* Failing to compile only loses the fast path */
+		compile_pred_tree(filter, root);
+
 		/* We don't set root until we know it works */
 		barrier();
 		filter->root = root;
@@ -2392,6 +2549,11 @@ static struct test_filter_data_t {
 	DATA_REC(YES, 1, 1, 1, 1, 1, 1, 1, 1, "bdfh"),
 	DATA_REC(YES, 0, 1, 0, 1, 0, 1, 0, 1, ""),
 	DATA_REC(YES, 1, 0, 1, 0, 1, 0, 1, 0, "bdfh"),
+#undef FILTER
+#define FILTER "!(a == 1 && b == 1) && !(c == 1 || d == 1)"
+	DATA_REC(NO,  1, 1, 0, 0, 0, 0, 0, 0, "cd"),
+	DATA_REC(YES, 0, 1, 0, 0, 0, 0, 0, 0, ""),
+	DATA_REC(NO,  1, 0, 0, 1, 0, 0, 0, 0, ""),
 };
 
 #undef DATA_REC
@@ -2434,6 +2596,49 @@ static int test_walk_pred_cb(enum move_type move, struct filter_pred *pred,
 	return WALK_PRED_DEFAULT;
 }
 
+#define FILTER_BENCH_LOOPS	10000
+
+/*
+ * Report the per event cost of a test filter, compiled and as a tree
+ * walk. This is the cost that a filter adds to every event it is set on.
+ */
+static __init void ftrace_test_filter_speed(struct test_filter_data_t *d)
+{
+	struct event_filter *filter = NULL;
+	struct filter_prog_entry *prog;
+	u64 start, compiled, walked;
+	int i;
+
+	if (create_filter(&event_ftrace_test_filter, d->filter,
+			  false, &filter))
+		goto out;
+
+	prog = filter->prog;
+	if (!prog)
+		goto out;
+
+	preempt_disable();
+	start = local_clock();
+	for (i = 0; i < FILTER_BENCH_LOOPS; i++)
+		filter_match_preds(filter, &d->rec);
+	compiled = local_clock() - start;
+
+	filter->prog = NULL;
+	start = local_clock();
+	for (i = 0; i < FILTER_BENCH_LOOPS; i++)
+		filter_match_preds(filter, &d->rec);
+	walked = local_clock() - start;
+	filter->prog = prog;
+	preempt_enable();
+
+	do_div(compiled, FILTER_BENCH_LOOPS);
+	do_div(walked, FILTER_BENCH_LOOPS);
+	printk(KERN_INFO "ftrace filter '%s': %llu ns compiled, %llu ns tree walk\n",
+	       d->filter, compiled, walked);
+ out:
+	__free_filter(filter);
+}
+
 static __init int ftrace_test_event_filter(void)
 {
 	int i;
@@ -2467,6 +2672,13 @@ static __init int ftrace_test_event_filter(void)
 
 		test_pred_visited = 0;
 		err = filter_match_preds(filter, &d->rec);
+
+		/* The tree walk must give the same answer as the prog */
+		if (filter->prog && !test_pred_visited && err == d->match) {
+			kfree(filter->prog);
+			filter->prog = NULL;
+			err = filter_match_preds(filter, &d->rec);
+		}
 		preempt_enable();
 
 		__free_filter(filter);
@@ -2486,8 +2698,17 @@ static __init int ftrace_test_event_filter(void)
 		}
 	}
 
-	if (i == DATA_CNT)
-		printk(KERN_CONT "OK\n");
+	if (i != DATA_CNT)
+		return 0;
+
+	printk(KERN_CONT "OK\n");
+
+	for (i = 0; i < DATA_CNT; i++) {
+		if (i && !strcmp(test_filter_data[i].filter,
+				 test_filter_data[i - 1].filter))
+			continue;
+		ftrace_test_filter_speed(&test_filter_data[i]);
+	}
 
 	return 0;
 }
@@ -0,0 +1,1130 @@
+/*
+ * trace_events_hist - trace event hist triggers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A hist trigger aggregates the fields of every hit of an event into
+ * a hash table keyed by one or more of the event's fields, counting
+ * hits and summing values per key:
+ *
+ *   echo 'hist:keys=call_site:vals=bytes_req:sort=bytes_req.descending' \
+ *	> events/kmem/kmalloc/trigger
+ *   cat events/kmem/kmalloc/hist
+ *
+ * The table is filled from the tracepoint itself, in any context, so
+ * it is lockless: all elements are allocated when the trigger is set
+ * and new keys claim a slot in an open addressed table with cmpxchg().
+ * Once the elements run out, hits on new keys are counted as dropped.
+ */
+
+#include <linux/module.h>
+#include <linux/kallsyms.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
+
+#include "trace.h"
+
+#define HIST_MAP_BITS_MIN	7
+#define HIST_MAP_BITS_MAX	17
+#define HIST_MAP_BITS_DEFAULT	11
+
+#define HIST_KEYS_MAX		3
+#define HIST_VALS_MAX		4	/* including hitcount */
+#define HIST_KEY_STR_MAX	32
+#define HIST_KEY_SIZE_MAX	(HIST_KEYS_MAX * HIST_KEY_STR_MAX)
+
+/* times to retry on a slot whose element is still being published */
+#define HIST_MAP_RETRIES	16
+
+struct hist_field;
+
+typedef u64 (*hist_field_fn_t) (struct hist_field *field, void *event);
+
+enum hist_field_flags {
+	HIST_FIELD_FL_HITCOUNT		= 1 << 0,
+	HIST_FIELD_FL_KEY		= 1 << 1,
+	HIST_FIELD_FL_STRING		= 1 << 2,
+	HIST_FIELD_FL_HEX		= 1 << 3,
+	HIST_FIELD_FL_SYM		= 1 << 4,
+	HIST_FIELD_FL_LOG2		= 1 << 5,
+};
+
+struct hist_field {
+	struct ftrace_event_field	*field;
+	unsigned long			flags;
+	hist_field_fn_t			fn;
+	unsigned int			size;	/* bytes used in the key */
+	unsigned int			offset;	/* offset in the key */
+};
+
+struct hist_elt {
+	struct hist_trigger_data	*hist_data;
+	atomic64_t			sums[HIST_VALS_MAX];
+	u64				key[0];
+};
+
+struct hist_map_entry {
+	u32				key;	/* hash of the key, 0 if free */
+	struct hist_elt			*val;
+};
+
+struct hist_map {
+	unsigned int			map_bits;
+	unsigned int			map_size;
+	unsigned int			max_elts;
+	unsigned int			key_size;
+	struct hist_map_entry		*map;
+	struct hist_elt			**elts;
+	atomic_t			next_elt;
+	atomic64_t			drops;
+};
+
+struct hist_trigger_attrs {
+	char				*keys_str;
+	char				*vals_str;
+	char				*sort_key_str;
+	bool				pause;
+	bool				cont;
+	bool				clear;
+	unsigned int			map_bits;
+};
+
+struct hist_trigger_data {
+	struct hist_field		keys[HIST_KEYS_MAX];
+	struct hist_field		vals[HIST_VALS_MAX];
+	unsigned int			n_keys;
+	unsigned int			n_vals;
+	unsigned int			key_size;
+	struct hist_field		*sort_field;
+	bool				sort_descending;
+	bool				paused;
+	struct hist_trigger_attrs	*attrs;
+	struct hist_map			*map;
+};
+
+static u64 hist_field_counter(struct hist_field *field, void *event)
+{
+	return 1;
+}
+
+static u64 hist_field_cpu(struct hist_field *field, void *event)
+{
+	return raw_smp_processor_id();
+}
+
+#define DEFINE_HIST_FIELD_FN(type)					\
+static u64 hist_field_##type(struct hist_field *hist_field, void *event)\
+{									\
+	type *addr = (type *)(event + hist_field->field->offset);	\
+									\
+	return (u64)*addr;						\
+}
+
+DEFINE_HIST_FIELD_FN(s64);
+DEFINE_HIST_FIELD_FN(u64);
+DEFINE_HIST_FIELD_FN(s32);
+DEFINE_HIST_FIELD_FN(u32);
+DEFINE_HIST_FIELD_FN(s16);
+DEFINE_HIST_FIELD_FN(u16);
+DEFINE_HIST_FIELD_FN(s8);
+DEFINE_HIST_FIELD_FN(u8);
+
+static bool is_string_field(struct ftrace_event_field *field)
+{
+	return field->filter_type == FILTER_DYN_STRING ||
+	       field->filter_type == FILTER_STATIC_STRING ||
+	       field->filter_type == FILTER_PTR_STRING;
+}
+
+static hist_field_fn_t select_value_fn(int field_size, int field_is_signed)
+{
+	switch (field_size) {
+	case 8:
+		return field_is_signed ? hist_field_s64 : hist_field_u64;
+	case 4:
+		return field_is_signed ? hist_field_s32 : hist_field_u32;
+	case 2:
+		return field_is_signed ? hist_field_s16 : hist_field_u16;
+	case 1:
+		return field_is_signed ? hist_field_s8 : hist_field_u8;
+	}
+
+	return NULL;
+}
+
+/* Copy a string field of @event into @key, at most HIST_KEY_STR_MAX - 1 */
+static void hist_field_copy_str(struct hist_field *hist_field, void *event,
+				char *key)
+{
+	struct ftrace_event_field *field = hist_field->field;
+	unsigned int len = HIST_KEY_STR_MAX - 1;
+	char *str;
+
+	switch (field->filter_type) {
+	case FILTER_DYN_STRING: {
+		u32 str_item = *(u32 *)(event + field->offset);
+
+		str = (char *)(event + (str_item & 0xffff));
+		len = min(len, str_item >> 16);
+		break;
+	}
+	case FILTER_PTR_STRING:
+		str = *(char **)(event + field->offset);
+		if (!str)
+			return;
+		break;
+	case FILTER_COMM:
+		str = current->comm;
+		break;
+	default:
+		str = (char *)(event + field->offset);
+		len = min_t(unsigned int, len, field->size);
+		break;
+	}
+
+	strncpy(key, str, len);
+}
+
+static u64 hist_field_log2(u64 val)
+{
+	return val ? fls64(val) - 1 : 0;
+}
+
+static struct hist_map *hist_map_alloc(unsigned int map_bits,
+				       unsigned int key_size,
+				       struct hist_trigger_data *hist_data)
+{
+	struct hist_map *map;
+	unsigned int i;
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return NULL;
+
+	map->map_bits = map_bits;
+	map->max_elts = 1 << map_bits;
+	/* twice the elements, so the table never gets crowded */
+	map->map_size = map->max_elts * 2;
+	map->key_size = key_size;
+
+	map->map = vzalloc(map->map_size * sizeof(*map->map));
+	if (!map->map)
+		goto free;
+
+	map->elts = vzalloc(map->max_elts * sizeof(*map->elts));
+	if (!map->elts)
+		goto free;
+
+	for (i = 0; i < map->max_elts; i++) {
+		map->elts[i] = kzalloc(sizeof(struct hist_elt) + key_size,
+				       GFP_KERNEL);
+		if (!map->elts[i])
+			goto free;
+		map->elts[i]->hist_data = hist_data;
+	}
+
+	return map;
+ free:
+	if (map->elts) {
+		for (i = 0; i < map->max_elts; i++)
+			kfree(map->elts[i]);
+		vfree(map->elts);
+	}
+	vfree(map->map);
+	kfree(map);
+	return NULL;
+}
+
+static void hist_map_free(struct hist_map *map)
+{
+	unsigned int i;
+
+	if (!map)
+		return;
+
+	for (i = 0; i < map->max_elts; i++)
+		kfree(map->elts[i]);
+	vfree(map->elts);
+	vfree(map->map);
+	kfree(map);
+}
+
+/* Must not run concurrently with hist_map_insert() */
+static void hist_map_clear(struct hist_map *map)
+{
+	unsigned int i;
+
+	for (i = 0; i < map->max_elts; i++) {
+		struct hist_elt *elt = map->elts[i];
+
+		memset(elt->sums, 0, sizeof(elt->sums));
+		memset(elt->key, 0, map->key_size);
+	}
+	memset(map->map, 0, map->map_size * sizeof(*map->map));
+	atomic_set(&map->next_elt, 0);
+	atomic64_set(&map->drops, 0);
+}
+
+static unsigned int hist_map_nr_elts(struct hist_map *map)
+{
+	return min_t(unsigned int, atomic_read(&map->next_elt), map->max_elts);
+}
+
+static struct hist_elt *hist_map_get_elt(struct hist_map *map)
+{
+	unsigned int idx;
+
+	/* don't let next_elt wrap around on a full map */
+	if (atomic_read(&map->next_elt) >= map->max_elts)
+		return NULL;
+
+	idx = atomic_inc_return(&map->next_elt) - 1;
+	if (idx >= map->max_elts)
+		return NULL;
+
+	return map->elts[idx];
+}
+
+/*
+ * Find the element for @key, adding it if it is not there yet.
+ * Returns NULL, and counts a drop, if the key could not be added.
+ */
+static struct hist_elt *hist_map_insert(struct hist_map *map, void *key)
+{
+	struct hist_map_entry *entry;
+	struct hist_elt *elt;
+	u32 idx, key_hash;
+	int retries = 0;
+
+	key_hash = jhash(key, map->key_size, 0);
+	if (key_hash == 0)
+		key_hash = 1;
+
+	idx = key_hash >> (32 - (map->map_bits + 1));
+
+	while (1) {
+		idx &= (map->map_size - 1);
+		entry = &map->map[idx];
+
+		if (READ_ONCE(entry->key) == key_hash) {
+			elt = lockless_dereference(entry->val);
+			if (elt) {
+				if (!memcmp(elt->key, key, map->key_size))
+					return elt;
+			} else if (++retries < HIST_MAP_RETRIES) {
+				/* someone is still adding the element */
+				cpu_relax();
+				continue;
+			} else {
+				break;
+			}
+		}
+
+		if (!READ_ONCE(entry->key)) {
+			if (cmpxchg(&entry->key, 0, key_hash)) {
+				/* lost the race, look at the winner */
+				continue;
+			}
+
+			elt = hist_map_get_elt(map);
+			if (!elt) {
+				WRITE_ONCE(entry->key, 0);
+				break;
+			}
+
+			memcpy(elt->key, key, map->key_size);
+			/* the key must be visible before the element is */
+			smp_wmb();
+			WRITE_ONCE(entry->val, elt);
+
+			return elt;
+		}
+
+		idx++;
+	}
+
+	atomic64_inc(&map->drops);
+	return NULL;
+}
+
+static void event_hist_trigger(struct event_trigger_data *data, void *rec)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	u64 compound_key[HIST_KEY_SIZE_MAX / sizeof(u64)];
+	struct hist_field *hist_field;
+	struct hist_elt *elt;
+	unsigned int i;
+	u64 val;
+
+	if (!rec || READ_ONCE(hist_data->paused))
+		return;
+
+	memset(compound_key, 0, hist_data->key_size);
+
+	for (i = 0; i < hist_data->n_keys; i++) {
+		hist_field = &hist_data->keys[i];
+
+		if (hist_field->flags & HIST_FIELD_FL_STRING) {
+			hist_field_copy_str(hist_field, rec,
+					    (char *)compound_key +
+					    hist_field->offset);
+			continue;
+		}
+
+		val = hist_field->fn(hist_field, rec);
+		if (hist_field->flags & HIST_FIELD_FL_LOG2)
+			val = hist_field_log2(val);
+		memcpy((char *)compound_key + hist_field->offset, &val,
+		       sizeof(val));
+	}
+
+	elt = hist_map_insert(hist_data->map, compound_key);
+	if (!elt)
+		return;
+
+	for (i = 0; i < hist_data->n_vals; i++) {
+		hist_field = &hist_data->vals[i];
+		val = hist_field->fn(hist_field, rec);
+		atomic64_add(val, &elt->sums[i]);
+	}
+}
+
+static void destroy_hist_trigger_attrs(struct hist_trigger_attrs *attrs)
+{
+	if (!attrs)
+		return;
+
+	kfree(attrs->keys_str);
+	kfree(attrs->vals_str);
+	kfree(attrs->sort_key_str);
+	kfree(attrs);
+}
+
+static struct hist_trigger_attrs *parse_hist_trigger_attrs(char *trigger_str)
+{
+	struct hist_trigger_attrs *attrs;
+	unsigned long size;
+	char *str, **dest;
+	int ret = -EINVAL;
+
+	attrs = kzalloc(sizeof(*attrs), GFP_KERNEL);
+	if (!attrs)
+		return ERR_PTR(-ENOMEM);
+
+	attrs->map_bits = HIST_MAP_BITS_DEFAULT;
+
+	while (trigger_str) {
+		str = strsep(&trigger_str, ":");
+
+		dest = NULL;
+		if (!strncmp(str, "keys=", strlen("keys=")) ||
+		    !strncmp(str, "key=", strlen("key=")))
+			dest = &attrs->keys_str;
+		else if (!strncmp(str, "vals=", strlen("vals=")) ||
+			 !strncmp(str, "values=", strlen("values=")))
+			dest = &attrs->vals_str;
+		else if (!strncmp(str, "sort=", strlen("sort=")))
+			dest = &attrs->sort_key_str;
+
+		if (dest) {
+			kfree(*dest);
+			*dest = kstrdup(strchr(str, '=') + 1, GFP_KERNEL);
+			if (!*dest) {
+				ret = -ENOMEM;
+				goto free;
+			}
+		} else if (!strncmp(str, "size=", strlen("size="))) {
+			if (kstrtoul(str + strlen("size="), 0, &size) || !size)
+				goto free;
+			size = roundup_pow_of_two(size);
+			attrs->map_bits = ilog2(size);
+			if (attrs->map_bits < HIST_MAP_BITS_MIN ||
+			    attrs->map_bits > HIST_MAP_BITS_MAX)
+				goto free;
+		} else if (!strcmp(str, "pause")) {
+			attrs->pause = true;
+		} else if (!strcmp(str, "cont") || !strcmp(str, "continue")) {
+			attrs->cont = true;
+		} else if (!strcmp(str, "clear")) {
+			attrs->clear = true;
+		} else {
+			goto free;
+		}
+	}
+
+	if (!attrs->keys_str)
+		goto free;
+
+	return attrs;
+ free:
+	destroy_hist_trigger_attrs(attrs);
+	return ERR_PTR(ret);
+}
+
+static int parse_hist_field(struct hist_trigger_data *hist_data,
+			    struct trace_event_file *file,
+			    struct hist_field *hist_field, char *str,
+			    unsigned long flags)
+{
+	struct ftrace_event_field *field;
+	char *field_name, *modifier;
+
+	field_name = strsep(&str, ".");
+	modifier = str;
+
+	if (modifier) {
+		if (!strcmp(modifier, "hex"))
+			flags |= HIST_FIELD_FL_HEX;
+		else if (!strcmp(modifier, "sym"))
+			flags |= HIST_FIELD_FL_SYM;
+		else if (!strcmp(modifier, "log2") &&
+			 (flags & HIST_FIELD_FL_KEY))
+			flags |= HIST_FIELD_FL_LOG2;
+		else
+			return -EINVAL;
+	}
+
+	field = trace_find_event_field(file->event_call, field_name);
+	if (!field)
+		return -EINVAL;
+
+	hist_field->field = field;
+
+	if (field->filter_type == FILTER_CPU) {
+		hist_field->fn = hist_field_cpu;
+	} else if (is_string_field(field) ||
+		   field->filter_type == FILTER_COMM) {
+		/* strings can only be keys, and not modified */
+		if (!(flags & HIST_FIELD_FL_KEY) || modifier)
+			return -EINVAL;
+		flags |= HIST_FIELD_FL_STRING;
+	} else {
+		hist_field->fn = select_value_fn(field->size,
+						 field->is_signed);
+		if (!hist_field->fn)
+			return -EINVAL;
+	}
+
+	hist_field->flags = flags;
+
+	if (flags & HIST_FIELD_FL_KEY) {
+		hist_field->offset = hist_data->key_size;
+		hist_field->size = (flags & HIST_FIELD_FL_STRING) ?
+			HIST_KEY_STR_MAX : sizeof(u64);
+		hist_data->key_size += hist_field->size;
+	}
+
+	return 0;
+}
+
+static int create_key_fields(struct hist_trigger_data *hist_data,
+			     struct trace_event_file *file)
+{
+	char *fields_str = hist_data->attrs->keys_str;
+	char *field_str;
+	int ret;
+
+	while ((field_str = strsep(&fields_str, ","))) {
+		if (hist_data->n_keys == HIST_KEYS_MAX)
+			return -EINVAL;
+
+		ret = parse_hist_field(hist_data, file,
+				       &hist_data->keys[hist_data->n_keys],
+				       field_str, HIST_FIELD_FL_KEY);
+		if (ret)
+			return ret;
+
+		hist_data->n_keys++;
+	}
+
+	return hist_data->n_keys ? 0 : -EINVAL;
+}
+
+static int create_val_fields(struct hist_trigger_data *hist_data,
+			     struct trace_event_file *file)
+{
+	char *fields_str = hist_data->attrs->vals_str;
+	struct hist_field *hist_field;
+	char *field_str;
+	int ret;
+
+	/* hitcount is always the first value */
+	hist_field = &hist_data->vals[hist_data->n_vals++];
+	hist_field->flags = HIST_FIELD_FL_HITCOUNT;
+	hist_field->fn = hist_field_counter;
+
+	while ((field_str = strsep(&fields_str, ","))) {
+		if (!strcmp(field_str, "hitcount"))
+			continue;
+
+		if (hist_data->n_vals == HIST_VALS_MAX)
+			return -EINVAL;
+
+		hist_field = &hist_data->vals[hist_data->n_vals];
+		ret = parse_hist_field(hist_data, file, hist_field,
+				       field_str, 0);
+		if (ret)
+			return ret;
+
+		/* only numbers can be summed up */
+		if (hist_field->flags & HIST_FIELD_FL_STRING)
+			return -EINVAL;
+
+		hist_data->n_vals++;
+	}
+
+	return 0;
+}
+
+static const char *hist_field_name(struct hist_field *hist_field)
+{
+	if (hist_field->flags & HIST_FIELD_FL_HITCOUNT)
+		return "hitcount";
+
+	return hist_field->field->name;
+}
+
+static int create_sort_key(struct hist_trigger_data *hist_data)
+{
+	char *field_str = hist_data->attrs->sort_key_str;
+	char *field_name, *order;
+	unsigned int i;
+
+	/* the default is to sort by hitcount */
+	hist_data->sort_field = &hist_data->vals[0];
+
+	if (!field_str)
+		return 0;
+
+	field_name = strsep(&field_str, ".");
+	order = field_str;
+
+	if (order) {
+		if (!strcmp(order, "descending"))
+			hist_data->sort_descending = true;
+		else if (strcmp(order, "ascending"))
+			return -EINVAL;
+	}
+
+	for (i = 0; i < hist_data->n_vals; i++) {
+		if (!strcmp(field_name, hist_field_name(&hist_data->vals[i]))) {
+			hist_data->sort_field = &hist_data->vals[i];
+			return 0;
+		}
+	}
+
+	for (i = 0; i < hist_data->n_keys; i++) {
+		if (!strcmp(field_name, hist_field_name(&hist_data->keys[i]))) {
+			hist_data->sort_field = &hist_data->keys[i];
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static void destroy_hist_data(struct hist_trigger_data *hist_data)
+{
+	if (!hist_data)
+		return;
+
+	destroy_hist_trigger_attrs(hist_data->attrs);
+	hist_map_free(hist_data->map);
+	kfree(hist_data);
+}
+
+static struct hist_trigger_data *
+create_hist_data(struct hist_trigger_attrs *attrs,
+		 struct trace_event_file *file)
+{
+	struct hist_trigger_data *hist_data;
+	int ret;
+
+	hist_data = kzalloc(sizeof(*hist_data), GFP_KERNEL);
+	if (!hist_data)
+		return ERR_PTR(-ENOMEM);
+
+	hist_data->attrs = attrs;
+
+	ret = create_key_fields(hist_data, file);
+	if (!ret)
+		ret = create_val_fields(hist_data, file);
+	if (!ret)
+		ret = create_sort_key(hist_data);
+	if (ret)
+		goto free;
+
+	hist_data->map = hist_map_alloc(attrs->map_bits, hist_data->key_size,
+					hist_data);
+	if (!hist_data->map) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	return hist_data;
+ free:
+	/* the caller still owns attrs on failure */
+	hist_data->attrs = NULL;
+	destroy_hist_data(hist_data);
+	return ERR_PTR(ret);
+}
+
+static void hist_field_print(struct seq_file *m, struct hist_field *hist_field)
+{
+	seq_puts(m, hist_field_name(hist_field));
+
+	if (hist_field->flags & HIST_FIELD_FL_HEX)
+		seq_puts(m, ".hex");
+	else if (hist_field->flags & HIST_FIELD_FL_SYM)
+		seq_puts(m, ".sym");
+	else if (hist_field->flags & HIST_FIELD_FL_LOG2)
+		seq_puts(m, ".log2");
+}
+
+static int event_hist_trigger_print(struct seq_file *m,
+				    struct event_trigger_ops *ops,
+				    struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	unsigned int i;
+
+	seq_puts(m, "hist:keys=");
+
+	for (i = 0; i < hist_data->n_keys; i++) {
+		if (i)
+			seq_putc(m, ',');
+		hist_field_print(m, &hist_data->keys[i]);
+	}
+
+	seq_puts(m, ":vals=");
+
+	for (i = 0; i < hist_data->n_vals; i++) {
+		if (i)
+			seq_putc(m, ',');
+		hist_field_print(m, &hist_data->vals[i]);
+	}
+
+	seq_printf(m, ":sort=%s", hist_field_name(hist_data->sort_field));
+	if (hist_data->sort_descending)
+		seq_puts(m, ".descending");
+
+	seq_printf(m, ":size=%u", hist_data->map->max_elts);
+
+	if (data->filter_str)
+		seq_printf(m, " if %s", data->filter_str);
+
+	if (hist_data->paused)
+		seq_puts(m, " [paused]");
+	else
+		seq_puts(m, " [active]");
+
+	seq_putc(m, '\n');
+
+	return 0;
+}
+
+static int event_hist_trigger_init(struct event_trigger_ops *ops,
+				   struct event_trigger_data *data)
+{
+	data->ref++;
+	return 0;
+}
+
+static void event_hist_trigger_free(struct event_trigger_ops *ops,
+				    struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+
+	if (WARN_ON_ONCE(data->ref <= 0))
+		return;
+
+	data->ref--;
+	if (!data->ref) {
+		/* waits for the trigger to be out of use */
+		trigger_data_free(data);
+		destroy_hist_data(hist_data);
+	}
+}
+
+static struct event_trigger_ops event_hist_trigger_ops = {
+	.func			= event_hist_trigger,
+	.print			= event_hist_trigger_print,
+	.init			= event_hist_trigger_init,
+	.free			= event_hist_trigger_free,
+};
+
+static struct event_trigger_ops *event_hist_get_trigger_ops(char *cmd,
+							    char *param)
+{
+	return &event_hist_trigger_ops;
+}
+
+static void hist_clear(struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	bool paused;
+
+	paused = hist_data->paused;
+	hist_data->paused = true;
+
+	/* make sure nobody is updating the map anymore */
+	synchronize_sched();
+
+	hist_map_clear(hist_data->map);
+
+	hist_data->paused = paused;
+}
+
+static int hist_register_trigger(char *glob, struct event_trigger_ops *ops,
+				 struct event_trigger_data *data,
+				 struct trace_event_file *file)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_trigger_data *test_data;
+	struct event_trigger_data *test;
+	int ret = 0;
+
+	list_for_each_entry_rcu(test, &file->triggers, list) {
+		if (test->cmd_ops->trigger_type != ETT_EVENT_HIST)
+			continue;
+
+		test_data = test->private_data;
+
+		/* pause, cont and clear act on the existing trigger */
+		if (hist_data->attrs->pause)
+			test_data->paused = true;
+		else if (hist_data->attrs->cont)
+			test_data->paused = false;
+		else if (hist_data->attrs->clear)
+			hist_clear(test);
+		else
+			ret = -EEXIST;
+		goto out;
+	}
+
+	if (hist_data->attrs->cont || hist_data->attrs->clear) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	if (hist_data->attrs->pause)
+		hist_data->paused = true;
+
+	if (data->ops->init) {
+		ret = data->ops->init(data->ops, data);
+		if (ret < 0)
+			goto out;
+	}
+
+	list_add_rcu(&data->list, &file->triggers);
+	ret++;
+
+	update_cond_flag(file);
+
+	if (trace_event_trigger_enable_disable(file, 1) < 0) {
+		list_del_rcu(&data->list);
+		update_cond_flag(file);
+		ret--;
+	}
+ out:
+	return ret;
+}
+
+static int event_hist_trigger_func(struct event_command *cmd_ops,
+				   struct trace_event_file *file,
+				   char *glob, char *cmd, char *param)
+{
+	struct hist_trigger_attrs *attrs;
+	struct event_trigger_ops *trigger_ops;
+	struct hist_trigger_data *hist_data;
+	struct event_trigger_data *trigger_data;
+	char *trigger;
+	int ret = 0;
+
+	if (!param)
+		return -EINVAL;
+
+	/* separate the trigger from the filter (k:v [if filter]) */
+	trigger = strsep(&param, " \t");
+	if (!trigger)
+		return -EINVAL;
+
+	attrs = parse_hist_trigger_attrs(trigger);
+	if (IS_ERR(attrs))
+		return PTR_ERR(attrs);
+
+	hist_data = create_hist_data(attrs, file);
+	if (IS_ERR(hist_data)) {
+		destroy_hist_trigger_attrs(attrs);
+		return PTR_ERR(hist_data);
+	}
+
+	trigger_ops = cmd_ops->get_trigger_ops(cmd, trigger);
+
+	ret = -ENOMEM;
+	trigger_data = kzalloc(sizeof(*trigger_data), GFP_KERNEL);
+	if (!trigger_data)
+		goto out_free;
+
+	trigger_data->count = -1;
+	trigger_data->ops = trigger_ops;
+	trigger_data->cmd_ops = cmd_ops;
+
+	INIT_LIST_HEAD(&trigger_data->list);
+	RCU_INIT_POINTER(trigger_data->filter, NULL);
+
+	trigger_data->private_data = hist_data;
+
+	if (glob[0] == '!') {
+		cmd_ops->unreg(glob+1, trigger_ops, trigger_data, file);
+		ret = 0;
+		goto out_free;
+	}
+
+	if (!param) /* if param is non-empty, it's supposed to be a filter */
+		goto out_reg;
+
+	if (!cmd_ops->set_filter)
+		goto out_reg;
+
+	ret = cmd_ops->set_filter(param, trigger_data, file);
+	if (ret < 0)
+		goto out_free;
+ out_reg:
+	ret = cmd_ops->reg(glob, trigger_ops, trigger_data, file);
+	/*
+	 * The above returns on success the # of triggers registered,
+	 * but if it didn't register any it returns zero.  That is
+	 * only fine if pause, cont or clear was applied to an existing
+	 * trigger, in which case the new trigger data is not needed.
+	 */
+	if (ret > 0)
+		return 0;
+
+	if (!ret && !attrs->pause && !attrs->cont && !attrs->clear)
+		ret = -ENOENT;
+ out_free:
+	if (cmd_ops->set_filter)
+		cmd_ops->set_filter(NULL, trigger_data, NULL);
+
+	kfree(trigger_data);
+
+	destroy_hist_data(hist_data);
+	return ret;
+}
+
+static struct event_command trigger_hist_cmd = {
+	.name			= "hist",
+	.trigger_type		= ETT_EVENT_HIST,
+	.needs_rec		= true,
+	.func			= event_hist_trigger_func,
+	.reg			= hist_register_trigger,
+	.unreg			= unregister_trigger,
+	.get_trigger_ops	= event_hist_get_trigger_ops,
+	.set_filter		= set_trigger_filter,
+};
+
+__init int register_trigger_hist_cmd(void)
+{
+	int ret;
+
+	ret = register_event_command(&trigger_hist_cmd);
+	WARN_ON(ret < 0);
+
+	return ret;
+}
+
+/*
+ * Reading the hist file
+ */
+
+static u64 hist_elt_key_val(const struct hist_elt *elt,
+			    struct hist_field *key)
+{
+	u64 val;
+
+	memcpy(&val, (char *)elt->key + key->offset, sizeof(val));
+	return val;
+}
+
+static int cmp_hist_elts(const void *a, const void *b)
+{
+	const struct hist_elt *elt_a = *(const struct hist_elt **)a;
+	const struct hist_elt *elt_b = *(const struct hist_elt **)b;
+	struct hist_trigger_data *hist_data = elt_a->hist_data;
+	struct hist_field *sort_field = hist_data->sort_field;
+	int ret = 0;
+
+	if (sort_field->flags & HIST_FIELD_FL_STRING) {
+		ret = strncmp((char *)elt_a->key + sort_field->offset,
+			      (char *)elt_b->key + sort_field->offset,
+			      HIST_KEY_STR_MAX);
+	} else {
+		u64 val_a, val_b;
+
+		if (sort_field->flags & HIST_FIELD_FL_KEY) {
+			val_a = hist_elt_key_val(elt_a, sort_field);
+			val_b = hist_elt_key_val(elt_b, sort_field);
+		} else {
+			int i = sort_field - hist_data->vals;
+
+			val_a = atomic64_read(&elt_a->sums[i]);
+			val_b = atomic64_read(&elt_b->sums[i]);
+		}
+
+		if (sort_field->field && sort_field->field->is_signed &&
+		    !(sort_field->flags & HIST_FIELD_FL_LOG2)) {
+			if ((s64)val_a != (s64)val_b)
+				ret = (s64)val_a > (s64)val_b ? 1 : -1;
+		} else if (val_a != val_b) {
+			ret = val_a > val_b ? 1 : -1;
+		}
+	}
+
+	return hist_data->sort_descending ? -ret : ret;
+}
+
+static void hist_print_val(struct seq_file *m, struct hist_field *hist_field,
+			   u64 val)
+{
+	char str[KSYM_SYMBOL_LEN];
+
+	if (hist_field->flags & HIST_FIELD_FL_HEX) {
+		seq_printf(m, "%llx", val);
+	} else if (hist_field->flags & HIST_FIELD_FL_SYM) {
+		sprint_symbol_no_offset(str, (unsigned long)val);
+		seq_printf(m, "[%llx] %-45s", val, str);
+	} else if (hist_field->flags & HIST_FIELD_FL_LOG2) {
+		seq_printf(m, "~ 2^%-2llu", val);
+	} else if (hist_field->field && hist_field->field->is_signed) {
+		seq_printf(m, "%10lld", (s64)val);
+	} else {
+		seq_printf(m, "%10llu", val);
+	}
+}
+
+static void hist_trigger_entry_print(struct seq_file *m,
+				     struct hist_trigger_data *hist_data,
+				     struct hist_elt *elt)
+{
+	struct hist_field *key;
+	unsigned int i;
+
+	seq_puts(m, "{ ");
+
+	for (i = 0; i < hist_data->n_keys; i++) {
+		key = &hist_data->keys[i];
+
+		if (i)
+			seq_puts(m, ", ");
+		seq_printf(m, "%s: ", hist_field_name(key));
+
+		if (key->flags & HIST_FIELD_FL_STRING)
+			seq_printf(m, "%-*.*s", HIST_KEY_STR_MAX,
+				   HIST_KEY_STR_MAX,
+				   (char *)elt->key + key->offset);
+		else
+			hist_print_val(m, key, hist_elt_key_val(elt, key));
+	}
+
+	seq_puts(m, " }");
+
+	for (i = 0; i < hist_data->n_vals; i++) {
+		seq_printf(m, " %s: ", hist_field_name(&hist_data->vals[i]));
+		seq_printf(m, "%10llu", (u64)atomic64_read(&elt->sums[i]));
+	}
+
+	seq_putc(m, '\n');
+}
+
+static int hist_trigger_show(struct seq_file *m,
+			     struct event_trigger_data *data, int n)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+	struct hist_map *map = hist_data->map;
+	struct hist_elt **elts;
+	unsigned int i, n_elts;
+	u64 hits = 0;
+
+	if (n > 0)
+		seq_puts(m, "\n\n");
+
+	seq_puts(m, "# event histogram\n#\n# trigger info: ");
+	data->ops->print(m, data->ops, data);
+	seq_puts(m, "#\n\n");
+
+	/*
+	 * The trigger keeps handing out map->elts[] by index while we
+	 * print, so sort a private copy of the elements in use. Keys
+	 * being written concurrently may be sorted out of order, but
+	 * every element is printed exactly once.
+	 */
+	n_elts = hist_map_nr_elts(map);
+	elts = vmalloc(max(n_elts, 1U) * sizeof(*elts));
+	if (!elts)
+		return -ENOMEM;
+	memcpy(elts, map->elts, n_elts * sizeof(*elts));
+	sort(elts, n_elts, sizeof(*elts), cmp_hist_elts, NULL);
+
+	for (i = 0; i < n_elts; i++) {
+		hist_trigger_entry_print(m, hist_data, elts[i]);
+		hits += atomic64_read(&elts[i]->sums[0]);
+	}
+	vfree(elts);
+
+	seq_printf(m, "\nTotals:\n    Hits: %llu\n    Entries: %u\n    Dropped: %llu\n",
+		   hits, n_elts, (u64)atomic64_read(&map->drops));
+
+	return 0;
+}
+
+static int hist_show(struct seq_file *m, void *v)
+{
+	struct event_trigger_data *data;
+	struct trace_event_file *event_file;
+	int n = 0, ret = 0;
+
+	mutex_lock(&event_mutex);
+
+	event_file = event_file_data(m->private);
+	if (unlikely(!event_file)) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	list_for_each_entry_rcu(data, &event_file->triggers, list) {
+		if (data->cmd_ops->trigger_type != ETT_EVENT_HIST)
+			continue;
+		ret = hist_trigger_show(m, data, n++);
+		if (ret)
+			break;
+	}
+
+ out_unlock:
+	mutex_unlock(&event_mutex);
+
+	return ret;
+}
+
+static int event_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hist_show, file);
+}
+
+const struct file_operations event_hist_fops = {
+	.open = event_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
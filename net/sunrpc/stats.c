@@ -139,6 +139,15 @@ void rpc_free_iostats(struct rpc_iostats *stats)
 }
 EXPORT_SYMBOL_GPL(rpc_free_iostats);
 
+static unsigned int rpc_iostats_hist_bucket(ktime_t delta)
+{
+	s64 usecs = ktime_to_us(delta);
+
+	if (usecs < 2)
+		return 0;
+	return min_t(unsigned int, ilog2(usecs), RPC_IOSTATS_HIST_BUCKETS - 1);
+}
+
 /**
  * rpc_count_iostats_metrics - tally up per-task stats
  * @task: completed rpc_task
@@ -167,9 +176,11 @@ void rpc_count_iostats_metrics(const struct rpc_task *task,
 	op_metrics->om_queue = ktime_add(op_metrics->om_queue, delta);
 
 	op_metrics->om_rtt = ktime_add(op_metrics->om_rtt, req->rq_rtt);
+	op_metrics->om_rtt_hist[rpc_iostats_hist_bucket(req->rq_rtt)]++;
 
 	delta = ktime_sub(now, task->tk_start);
 	op_metrics->om_execute = ktime_add(op_metrics->om_execute, delta);
+	op_metrics->om_execute_hist[rpc_iostats_hist_bucket(delta)]++;
 
 	spin_unlock(&op_metrics->om_lock);
 }
@@ -200,6 +211,27 @@ static void _print_name(struct seq_file *seq, unsigned int op,
 		seq_printf(seq, "\t%12u: ", op);
 }
 
+/*
+ * Histogram lines are keyed "<op>-<what>:" so that they never repeat the
+ * "<op>:" keys of the per-op statistics.
+ */
+static void _print_hist(struct seq_file *seq, unsigned int op,
+			struct rpc_procinfo *procs, const char *what,
+			const unsigned long *hist)
+{
+	unsigned int i;
+
+	if (procs[op].p_name)
+		seq_printf(seq, "\t%s-%s:", procs[op].p_name, what);
+	else if (op == 0)
+		seq_printf(seq, "\tNULL-%s:", what);
+	else
+		seq_printf(seq, "\t%u-%s:", op, what);
+	for (i = 0; i < RPC_IOSTATS_HIST_BUCKETS; i++)
+		seq_printf(seq, " %lu", hist[i]);
+	seq_putc(seq, '\n');
+}
+
 void rpc_print_iostats(struct seq_file *seq, struct rpc_clnt *clnt)
 {
 	struct rpc_iostats *stats = clnt->cl_metrics;
@@ -233,6 +265,24 @@ void rpc_print_iostats(struct seq_file *seq, struct rpc_clnt *clnt)
 				ktime_to_ms(metrics->om_rtt),
 				ktime_to_ms(metrics->om_execute));
 	}
+
+	/*
+	 * Histograms are only listed for procedures that have been used,
+	 * one line each for RTT and execution time, log2 usec buckets.
+	 * They follow the per-op statistics in a section of their own.
+	 */
+	seq_printf(seq, "\tper-op latency histograms (log2 usecs, %u buckets)\n",
+			RPC_IOSTATS_HIST_BUCKETS);
+	for (op = 0; op < maxproc; op++) {
+		struct rpc_iostats *metrics = &stats[op];
+
+		if (!metrics->om_ops)
+			continue;
+		_print_hist(seq, op, clnt->cl_procinfo, "rtt",
+			    metrics->om_rtt_hist);
+		_print_hist(seq, op, clnt->cl_procinfo, "execute",
+			    metrics->om_execute_hist);
+	}
 }
 EXPORT_SYMBOL_GPL(rpc_print_iostats);
 
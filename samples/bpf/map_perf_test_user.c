@@ -0,0 +1,143 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <asm/unistd.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <linux/bpf.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "libbpf.h"
+#include "bpf_load.h"
+
+#define MAX_CNT 1000000
+
+static __u64 time_get_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define HASH_MAP		(1 << 0)
+#define PERCPU_HASH		(1 << 1)
+#define SHARED_COUNT		(1 << 2)
+#define PERCPU_COUNT		(1 << 3)
+#define HASH_KMALLOC		(1 << 4)
+#define PERCPU_HASH_KMALLOC	(1 << 5)
+#define LRU_HASH		(1 << 6)
+
+static int test_flags = ~0;
+
+static void run_test(int cpu, int nr, const char *name)
+{
+	__u64 start_time;
+	int i;
+
+	start_time = time_get_ns();
+	for (i = 0; i < MAX_CNT; i++)
+		syscall(nr);
+	printf("%d:%s %lld events per sec\n",
+	       cpu, name, MAX_CNT * 1000000000ll / (time_get_ns() - start_time));
+}
+
+static void loop(int cpu)
+{
+	cpu_set_t cpuset;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	sched_setaffinity(0, sizeof(cpuset), &cpuset);
+
+	if (test_flags & HASH_MAP)
+		run_test(cpu, __NR_getuid, "hash_map_perf");
+	if (test_flags & PERCPU_HASH)
+		run_test(cpu, __NR_geteuid, "percpu_hash_map_perf");
+	if (test_flags & SHARED_COUNT)
+		run_test(cpu, __NR_getgid, "shared_count_perf");
+	if (test_flags & PERCPU_COUNT)
+		run_test(cpu, __NR_getegid, "percpu_count_perf");
+	if (test_flags & HASH_KMALLOC)
+		run_test(cpu, __NR_getpgid, "hash_kmalloc_perf");
+	if (test_flags & PERCPU_HASH_KMALLOC)
+		run_test(cpu, __NR_getpgrp, "percpu_hash_kmalloc_perf");
+	if (test_flags & LRU_HASH)
+		run_test(cpu, __NR_getppid, "lru_hash_map_perf");
+}
+
+static void run_perf_test(int tasks)
+{
+	pid_t pid[tasks];
+	int i;
+
+	for (i = 0; i < tasks; i++) {
+		pid[i] = fork();
+		if (pid[i] == 0) {
+			loop(i);
+			exit(0);
+		} else if (pid[i] == -1) {
+			printf("couldn't spawn #%d process\n", i);
+			exit(1);
+		}
+	}
+	for (i = 0; i < tasks; i++) {
+		int status;
+
+		assert(waitpid(pid[i], &status, 0) == pid[i]);
+		assert(status == 0);
+	}
+}
+
+/* per-cpu lookups return one 8-byte aligned value for every possible cpu */
+static void check_counts(int nr_cpus)
+{
+	long shared, values[nr_cpus], sum = 0;
+	int key = 0, i;
+
+	assert(bpf_lookup_elem(map_fd[2], &key, &shared) == 0);
+	assert(bpf_lookup_elem(map_fd[3], &key, values) == 0);
+	for (i = 0; i < nr_cpus; i++)
+		sum += values[i];
+
+	printf("shared counter %ld, sum of per-cpu counters %ld\n",
+	       shared, sum);
+}
+
+int main(int argc, char **argv)
+{
+	struct rlimit r = {RLIM_INFINITY, RLIM_INFINITY};
+	char filename[256];
+	int num_cpu, nr_cpus;
+
+	snprintf(filename, sizeof(filename), "%s_kern.o", argv[0]);
+	setrlimit(RLIMIT_MEMLOCK, &r);
+
+	if (argc > 1)
+		test_flags = atoi(argv[1]) ? : test_flags;
+
+	num_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (argc > 2)
+		num_cpu = atoi(argv[2]) ? : num_cpu;
+
+	if (load_bpf_file(filename)) {
+		printf("%s", bpf_log_buf);
+		return 1;
+	}
+
+	run_perf_test(num_cpu);
+	check_counts(nr_cpus);
+
+	return 0;
+}
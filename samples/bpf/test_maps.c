@@ -17,13 +17,16 @@
 #include <stdlib.h>
 #include "libbpf.h"
 
+static int map_flags;
+
 /* sanity tests for map API */
 static void test_hashmap_sanity(int i, void *data)
 {
 	long long key, next_key, value;
 	int map_fd;
 
-	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value), 2);
+	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value),
+				2, map_flags);
 	if (map_fd < 0) {
 		printf("failed to create hashmap '%s'\n", strerror(errno));
 		exit(1);
@@ -64,6 +67,13 @@ static void test_hashmap_sanity(int i, void *data)
 	assert(bpf_update_elem(map_fd, &key, &value, BPF_NOEXIST) == -1 &&
 	       errno == E2BIG);
 
+	/* update existing element, though the map is full */
+	key = 1;
+	assert(bpf_update_elem(map_fd, &key, &value, BPF_EXIST) == 0);
+	key = 2;
+	assert(bpf_update_elem(map_fd, &key, &value, BPF_ANY) == 0);
+	key = 0;
+
 	/* check that key = 0 doesn't exist */
 	assert(bpf_delete_elem(map_fd, &key) == -1 && errno == ENOENT);
 
@@ -94,7 +104,8 @@ static void test_arraymap_sanity(int i, void *data)
 	int key, next_key, map_fd;
 	long long value;
 
-	map_fd = bpf_create_map(BPF_MAP_TYPE_ARRAY, sizeof(key), sizeof(value), 2);
+	map_fd = bpf_create_map(BPF_MAP_TYPE_ARRAY, sizeof(key), sizeof(value),
+				2, 0);
 	if (map_fd < 0) {
 		printf("failed to create arraymap '%s'\n", strerror(errno));
 		exit(1);
@@ -143,6 +154,48 @@ static void test_arraymap_sanity(int i, void *data)
 }
 
 #define MAP_SIZE (32 * 1024)
+static void test_lru_hashmap_sanity(int i, void *data)
+{
+	long long key, value;
+	int map_fd;
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_LRU_HASH, sizeof(key),
+				sizeof(value), 2, 0);
+	if (map_fd < 0) {
+		printf("failed to create lru hashmap '%s'\n", strerror(errno));
+		exit(1);
+	}
+
+	/* insert key=1 and key=2 elements */
+	key = 1;
+	value = 1234;
+	assert(bpf_update_elem(map_fd, &key, &value, BPF_NOEXIST) == 0);
+	key = 2;
+	assert(bpf_update_elem(map_fd, &key, &value, BPF_NOEXIST) == 0);
+
+	/* reference key=1 so that key=2 becomes least recently used */
+	key = 1;
+	assert(bpf_lookup_elem(map_fd, &key, &value) == 0 && value == 1234);
+
+	/* the map is full, inserting key=3 evicts key=2 instead of failing */
+	key = 3;
+	assert(bpf_update_elem(map_fd, &key, &value, BPF_NOEXIST) == 0);
+
+	key = 2;
+	assert(bpf_lookup_elem(map_fd, &key, &value) == -1 && errno == ENOENT);
+	key = 1;
+	assert(bpf_lookup_elem(map_fd, &key, &value) == 0);
+	key = 3;
+	assert(bpf_lookup_elem(map_fd, &key, &value) == 0);
+
+	/* lru maps are always preallocated */
+	assert(bpf_create_map(BPF_MAP_TYPE_LRU_HASH, sizeof(key),
+			      sizeof(value), 2, BPF_F_NO_PREALLOC) == -1 &&
+	       errno == EINVAL);
+
+	close(map_fd);
+}
+
 static void test_map_large(void)
 {
 	struct bigkey {
@@ -154,7 +207,7 @@ static void test_map_large(void)
 
 	/* allocate 4Mbyte of memory */
 	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value),
-				MAP_SIZE);
+				MAP_SIZE, map_flags);
 	if (map_fd < 0) {
 		printf("failed to create large map '%s'\n", strerror(errno));
 		exit(1);
@@ -237,7 +290,7 @@ static void test_map_parallel(void)
 	int data[2];
 
 	map_fd = bpf_create_map(BPF_MAP_TYPE_HASH, sizeof(key), sizeof(value),
-				MAP_SIZE);
+				MAP_SIZE, map_flags);
 	if (map_fd < 0) {
 		printf("failed to create map for parallel test '%s'\n",
 		       strerror(errno));
@@ -279,13 +332,22 @@ static void test_map_parallel(void)
 	assert(bpf_get_next_key(map_fd, &key, &key) == -1 && errno == ENOENT);
 }
 
-int main(void)
+static void run_all_tests(void)
 {
 	test_hashmap_sanity(0, NULL);
 	test_arraymap_sanity(0, NULL);
+	test_lru_hashmap_sanity(0, NULL);
 	test_map_large();
 	test_map_parallel();
 	test_map_stress();
+}
+
+int main(void)
+{
+	map_flags = 0;
+	run_all_tests();
+	map_flags = BPF_F_NO_PREALLOC;
+	run_all_tests();
 	printf("test_maps: OK\n");
 	return 0;
 }
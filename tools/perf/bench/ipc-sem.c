@@ -0,0 +1,229 @@
+/*
+ * ipc-sem: measure SysV semaphore semop() scalability.
+ *
+ * Threads are paired up, and each pair ping-pongs over two semaphores
+ * of a single, shared semaphore set: one thread blocks in semop() on its
+ * semaphore until its partner posts it, then posts the partner's. Every
+ * operation therefore goes through the sleep and wakeup paths of
+ * ipc/sem.c, while the pairs contend on the same set.
+ *
+ * With --complex, each post also waits for zero on an extra semaphore
+ * that always stays zero, which turns every semop() into a multi-sop
+ * (complex) operation.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/stat.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+union semun {
+	int val;
+	struct semid_ds *buf;
+	unsigned short *array;
+};
+
+static unsigned int nthreads = 0;
+static unsigned int nsecs    = 10;
+static bool complex_ops = false, done = false, silent = false;
+static int semid;
+
+struct timeval start, end, runtime;
+static pthread_mutex_t thread_lock;
+static unsigned int threads_starting;
+static struct stats throughput_stats;
+static pthread_cond_t thread_parent, thread_worker;
+
+struct worker {
+	int tid;
+	unsigned short wait_sem;
+	unsigned short post_sem;
+	pthread_t thread;
+	unsigned long ops;
+};
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads (rounded up to an even number)"),
+	OPT_UINTEGER('r', "runtime", &nsecs,    "Specify runtime (in seconds)"),
+	OPT_BOOLEAN( 'c', "complex", &complex_ops, "Use multi-sop (complex) operations"),
+	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
+	OPT_END()
+};
+
+static const char * const bench_ipc_sem_usage[] = {
+	"perf bench ipc sem <options>",
+	NULL
+};
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = (struct worker *) arg;
+	struct sembuf wait_op = { w->wait_sem, -1, 0 };
+	struct sembuf post_ops[2] = {
+		{ w->post_sem, 1, 0 },
+		/* the last semaphore of the set is always zero */
+		{ nthreads, 0, IPC_NOWAIT },
+	};
+
+	pthread_mutex_lock(&thread_lock);
+	threads_starting--;
+	if (!threads_starting)
+		pthread_cond_signal(&thread_parent);
+	pthread_cond_wait(&thread_worker, &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+
+	do {
+		if (semop(semid, &wait_op, 1) ||
+		    semop(semid, post_ops, complex_ops ? 2 : 1)) {
+			/* the set is removed once the run is over */
+			if (errno != EIDRM && errno != EINVAL && !silent)
+				warn("semop");
+			break;
+		}
+		w->ops++;
+	} while (!done);
+
+	return NULL;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	/* inform all threads that we're done for the day */
+	done = true;
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &runtime);
+}
+
+static void print_summary(void)
+{
+	unsigned long avg = avg_stats(&throughput_stats);
+	double stddev = stddev_stats(&throughput_stats);
+
+	printf("%sAveraged %ld operations/sec (+- %.2f%%), total secs = %d\n",
+	       !silent ? "\n" : "", avg, rel_stddev_stats(stddev, avg),
+	       (int) runtime.tv_sec);
+}
+
+int bench_ipc_sem(int argc, const char **argv,
+		  const char *prefix __maybe_unused)
+{
+	int ret = 0;
+	cpu_set_t cpu;
+	struct sigaction act;
+	unsigned int i, ncpus;
+	pthread_attr_t thread_attr;
+	struct worker *worker = NULL;
+	union semun arg;
+
+	argc = parse_options(argc, argv, options, bench_ipc_sem_usage, 0);
+	if (argc) {
+		usage_with_options(bench_ipc_sem_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	if (!nthreads) /* default to the number of CPUs */
+		nthreads = ncpus;
+	nthreads = (nthreads + 1) & ~1U;
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	/* one semaphore per thread, plus the one that stays zero */
+	semid = semget(IPC_PRIVATE, nthreads + 1, IPC_CREAT | 0600);
+	if (semid < 0)
+		err(EXIT_FAILURE, "semget");
+
+	printf("Run summary [PID %d]: %d threads in %d pairs, [%s] semop() for %d secs.\n\n",
+	       getpid(), nthreads, nthreads / 2,
+	       complex_ops ? "complex" : "simple", nsecs);
+
+	init_stats(&throughput_stats);
+	pthread_mutex_init(&thread_lock, NULL);
+	pthread_cond_init(&thread_parent, NULL);
+	pthread_cond_init(&thread_worker, NULL);
+
+	threads_starting = nthreads;
+	pthread_attr_init(&thread_attr);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nthreads; i++) {
+		worker[i].tid = i;
+		worker[i].wait_sem = i;
+		worker[i].post_sem = i ^ 1;
+
+		/* the first thread of each pair goes first */
+		if (!(i & 1)) {
+			arg.val = 1;
+			if (semctl(semid, i, SETVAL, arg))
+				err(EXIT_FAILURE, "semctl");
+		}
+
+		CPU_ZERO(&cpu);
+		CPU_SET(i % ncpus, &cpu);
+
+		ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpu);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+		ret = pthread_create(&worker[i].thread, &thread_attr, workerfn,
+				     (void *)(struct worker *) &worker[i]);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	pthread_attr_destroy(&thread_attr);
+
+	pthread_mutex_lock(&thread_lock);
+	while (threads_starting)
+		pthread_cond_wait(&thread_parent, &thread_lock);
+	pthread_cond_broadcast(&thread_worker);
+	pthread_mutex_unlock(&thread_lock);
+
+	sleep(nsecs);
+	toggle_done(0, NULL, NULL);
+
+	/* kick the threads still blocked in semop() out with EIDRM */
+	if (semctl(semid, 0, IPC_RMID))
+		err(EXIT_FAILURE, "semctl");
+
+	for (i = 0; i < nthreads; i++) {
+		ret = pthread_join(worker[i].thread, NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	/* cleanup & report results */
+	pthread_cond_destroy(&thread_parent);
+	pthread_cond_destroy(&thread_worker);
+	pthread_mutex_destroy(&thread_lock);
+
+	for (i = 0; i < nthreads; i++) {
+		unsigned long t = worker[i].ops/runtime.tv_sec;
+		update_stats(&throughput_stats, t);
+		if (!silent)
+			printf("[thread %2d] sems: %d/%d [ %ld ops/sec ]\n",
+			       worker[i].tid, worker[i].wait_sem,
+			       worker[i].post_sem, t);
+	}
+
+	print_summary();
+
+	free(worker);
+	return ret;
+}